@@ -0,0 +1,259 @@
+#include <Bullet/BulletCollision/BroadphaseCollision/btBroadphaseProxy.h>
+#include <Bullet/BulletCollision/CollisionDispatch/btCollisionObject.h>
+#include <Bullet/BulletCollision/CollisionDispatch/btCollisionWorld.h>
+#include <Bullet/BulletCollision/CollisionShapes/btSphereShape.h>
+#include <Bullet/BulletDynamics/Dynamics/btDiscreteDynamicsWorld.h>
+#include <Urho3D/Physics/PhysicsUtils.h>
+#include <Urho3D/Physics/RigidBody.h>
+
+#include "BatchRaycaster.h"
+
+// Objects overlapping more grid cells than this are tested by every ray instead of binned
+static const int MAX_OBJECT_CELLS = 64;
+
+void BatchRaycaster::Cast(WorkQueue* pQueue, PhysicsWorld* pWorld, const PODVector<CastQuery>& queries, PODVector<PhysicsRaycastResult>& hits)
+{
+	hits.Resize(queries.Size());
+	if (queries.Empty())
+		return;
+
+	// Snapshot the broadphase on the main thread
+	btCollisionObjectArray& objects = pWorld->GetWorld()->getCollisionObjectArray();
+	snapshot.Resize((unsigned)objects.size());
+	unsigned numObjects = 0;
+	for (int i = 0; i < objects.size(); i++)
+	{
+		btCollisionObject* pObject = objects[i];
+		btBroadphaseProxy* pProxy = pObject->getBroadphaseHandle();
+		if (!pProxy)
+			continue;
+		SnapshotObject& s = snapshot[numObjects++];
+		s.pObject = pObject;
+		s.min = ToVector3(pProxy->m_aabbMin);
+		s.max = ToVector3(pProxy->m_aabbMax);
+		s.group = (unsigned)pProxy->m_collisionFilterGroup;
+	}
+	snapshot.Resize(numObjects);
+
+	// Grown by the widest sphere, so walking each sphere's centre line finds every object it can touch
+	float pad = 0.0f;
+	for (unsigned i = 0; i < queries.Size(); i++)
+		pad = Max(pad, queries[i].radius);
+	BuildGrid(pad);
+
+	// One item per thread, main thread included, so the thread count sets how wide a batch runs
+	unsigned numWorkers = pQueue->GetNumThreads() + 1;
+	unsigned itemSize = Max(batchSize, (queries.Size() + numWorkers - 1) / numWorkers);
+	pQueries = &queries[0];
+	pHits = &hits[0];
+	for (unsigned start = 0; start < queries.Size(); start += itemSize)
+	{
+		SharedPtr<WorkItem> item = pQueue->GetFreeItem();
+		item->priority_ = M_MAX_UNSIGNED;
+		item->workFunction_ = CastWork;
+		item->aux_ = this;
+		item->start_ = (void*)(size_t)start;
+		item->end_ = (void*)(size_t)Min(start + itemSize, queries.Size());
+		pQueue->AddWorkItem(item);
+	}
+	// The main thread helps out while waiting
+	pQueue->Complete(M_MAX_UNSIGNED);
+	pQueries = nullptr;
+	pHits = nullptr;
+}
+
+void BatchRaycaster::BuildGrid(float pad)
+{
+	invCellSize = 1.0f / cellSize;
+	Vector3 grow(pad, pad, pad);
+	largeObjects.Clear();
+
+	// Count the cell entries, setting aside objects too big to bin
+	unsigned numEntries = 0;
+	for (unsigned i = 0; i < snapshot.Size(); i++)
+	{
+		const SnapshotObject& s = snapshot[i];
+		Vector3 min = s.min - grow;
+		Vector3 max = s.max + grow;
+		int spanX = ToCell(max.x_) - ToCell(min.x_) + 1;
+		int spanY = ToCell(max.y_) - ToCell(min.y_) + 1;
+		int spanZ = ToCell(max.z_) - ToCell(min.z_) + 1;
+		if (spanX > MAX_OBJECT_CELLS || spanY > MAX_OBJECT_CELLS || spanZ > MAX_OBJECT_CELLS ||
+			spanX * spanY * spanZ > MAX_OBJECT_CELLS)
+			largeObjects.Push(i);
+		else
+			numEntries += spanX * spanY * spanZ;
+	}
+
+	// Twice as many buckets as entries keeps collisions rare
+	unsigned tableSize = 16;
+	while (tableSize < numEntries * 2)
+		tableSize <<= 1;
+	tableMask = tableSize - 1;
+	cellStart.Resize(tableSize + 1);
+	cellEntries.Resize(numEntries);
+	for (unsigned i = 0; i <= tableSize; i++)
+		cellStart[i] = 0;
+
+	// Counting sort of the entries by bucket: count, prefix sum, fill, shift back down as SpatialGrid does
+	for (int pass = 0; pass < 2; pass++)
+	{
+		unsigned large = 0;
+		for (unsigned i = 0; i < snapshot.Size(); i++)
+		{
+			if (large < largeObjects.Size() && largeObjects[large] == i)
+			{
+				large++;
+				continue;
+			}
+			const SnapshotObject& s = snapshot[i];
+			Vector3 min = s.min - grow;
+			Vector3 max = s.max + grow;
+			for (int x = ToCell(min.x_); x <= ToCell(max.x_); x++)
+			{
+				for (int y = ToCell(min.y_); y <= ToCell(max.y_); y++)
+				{
+					for (int z = ToCell(min.z_); z <= ToCell(max.z_); z++)
+					{
+						unsigned h = HashCell(x, y, z);
+						if (pass == 0)
+							cellStart[h + 1]++;
+						else
+							cellEntries[cellStart[h]++] = i;
+					}
+				}
+			}
+		}
+		if (pass == 0)
+		{
+			for (unsigned i = 0; i < tableSize; i++)
+				cellStart[i + 1] += cellStart[i];
+		}
+	}
+	for (unsigned i = tableSize; i > 0; i--)
+		cellStart[i] = cellStart[i - 1];
+	cellStart[0] = 0;
+}
+
+void BatchRaycaster::CastWork(const WorkItem* pItem, unsigned threadIndex)
+{
+	BatchRaycaster* pCaster = static_cast<BatchRaycaster*>(pItem->aux_);
+	unsigned start = (unsigned)(size_t)pItem->start_;
+	unsigned end = (unsigned)(size_t)pItem->end_;
+	for (unsigned i = start; i < end; i++)
+		pCaster->CastOne(pCaster->pQueries[i], pCaster->pHits[i]);
+}
+
+void BatchRaycaster::CastOne(const CastQuery& query, PhysicsRaycastResult& hit) const
+{
+	hit.position_ = Vector3::ZERO;
+	hit.normal_ = Vector3::ZERO;
+	hit.distance_ = M_INFINITY;
+	hit.hitFraction_ = 0.0f;
+	hit.body_ = nullptr;
+	float closest = query.maxDistance;
+
+	for (unsigned i = 0; i < largeObjects.Size(); i++)
+		TestObject(query, snapshot[largeObjects[i]], closest, hit);
+
+	// Walk the cells along the ray in order (Amanatides & Woo). An object is tested in the
+	// first cell where the ray meets it, so once a cell starts beyond the closest hit so far,
+	// nothing left can be closer.
+	const Vector3& from = query.ray.origin_;
+	const Vector3& dir = query.ray.direction_;
+	int x = ToCell(from.x_), y = ToCell(from.y_), z = ToCell(from.z_);
+	int stepX = dir.x_ > 0.0f ? 1 : -1;
+	int stepY = dir.y_ > 0.0f ? 1 : -1;
+	int stepZ = dir.z_ > 0.0f ? 1 : -1;
+	// Distance along the ray to the next boundary on each axis, and between boundaries
+	float nextX = dir.x_ != 0.0f ? ((x + (stepX > 0 ? 1 : 0)) * cellSize - from.x_) / dir.x_ : M_INFINITY;
+	float nextY = dir.y_ != 0.0f ? ((y + (stepY > 0 ? 1 : 0)) * cellSize - from.y_) / dir.y_ : M_INFINITY;
+	float nextZ = dir.z_ != 0.0f ? ((z + (stepZ > 0 ? 1 : 0)) * cellSize - from.z_) / dir.z_ : M_INFINITY;
+	float deltaX = dir.x_ != 0.0f ? cellSize / Abs(dir.x_) : M_INFINITY;
+	float deltaY = dir.y_ != 0.0f ? cellSize / Abs(dir.y_) : M_INFINITY;
+	float deltaZ = dir.z_ != 0.0f ? cellSize / Abs(dir.z_) : M_INFINITY;
+
+	// Objects span several cells and buckets can be shared, so test each object once
+	PODVector<unsigned> tested;
+	float entry = 0.0f;
+	while (entry < closest)
+	{
+		unsigned h = HashCell(x, y, z);
+		for (unsigned e = cellStart[h]; e < cellStart[h + 1]; e++)
+		{
+			unsigned i = cellEntries[e];
+			if (tested.Contains(i))
+				continue;
+			tested.Push(i);
+			TestObject(query, snapshot[i], closest, hit);
+		}
+
+		// Step into the neighbouring cell the ray reaches first
+		if (nextX <= nextY && nextX <= nextZ)
+		{
+			entry = nextX;
+			nextX += deltaX;
+			x += stepX;
+		}
+		else if (nextY <= nextZ)
+		{
+			entry = nextY;
+			nextY += deltaY;
+			y += stepY;
+		}
+		else
+		{
+			entry = nextZ;
+			nextZ += deltaZ;
+			z += stepZ;
+		}
+	}
+}
+
+void BatchRaycaster::TestObject(const CastQuery& query, const SnapshotObject& s, float& closest, PhysicsRaycastResult& hit) const
+{
+	if (!(s.group & query.collisionMask))
+		return;
+	// Cheap slab test against the bounds, grown by the sphere radius
+	Vector3 pad(query.radius, query.radius, query.radius);
+	float d = query.ray.HitDistance(BoundingBox(s.min - pad, s.max + pad));
+	if (d >= closest)
+		return;
+
+	Vector3 to = query.ray.origin_ + query.ray.direction_ * query.maxDistance;
+	btTransform fromTrans(btQuaternion::getIdentity(), ToBtVector3(query.ray.origin_));
+	btTransform toTrans(btQuaternion::getIdentity(), ToBtVector3(to));
+	btCollisionObject* pObject = s.pObject;
+	if (query.radius <= 0.0f)
+	{
+		btCollisionWorld::ClosestRayResultCallback result(fromTrans.getOrigin(), toTrans.getOrigin());
+		btCollisionWorld::rayTestSingle(fromTrans, toTrans, pObject, pObject->getCollisionShape(),
+			pObject->getWorldTransform(), result);
+		if (!result.hasHit() || result.m_closestHitFraction * query.maxDistance >= closest)
+			return;
+		closest = result.m_closestHitFraction * query.maxDistance;
+		hit.position_ = ToVector3(result.m_hitPointWorld);
+		hit.normal_ = ToVector3(result.m_hitNormalWorld);
+		hit.hitFraction_ = result.m_closestHitFraction;
+	}
+	else
+	{
+		btSphereShape sphere(query.radius);
+		btCollisionWorld::ClosestConvexResultCallback result(fromTrans.getOrigin(), toTrans.getOrigin());
+		btCollisionWorld::objectQuerySingle(&sphere, fromTrans, toTrans, pObject, pObject->getCollisionShape(),
+			pObject->getWorldTransform(), result, 0.0f);
+		if (!result.hasHit() || result.m_closestHitFraction * query.maxDistance >= closest)
+			return;
+		closest = result.m_closestHitFraction * query.maxDistance;
+		hit.position_ = ToVector3(result.m_hitPointWorld);
+		hit.normal_ = ToVector3(result.m_hitNormalWorld);
+		hit.hitFraction_ = result.m_closestHitFraction;
+	}
+	hit.distance_ = closest;
+	hit.body_ = static_cast<RigidBody*>(pObject->getUserPointer());
+}
+
+unsigned BatchRaycaster::HashCell(int x, int y, int z) const
+{
+	return ((unsigned)x * 73856093u ^ (unsigned)y * 19349663u ^ (unsigned)z * 83492791u) & tableMask;
+}
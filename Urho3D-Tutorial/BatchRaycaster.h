@@ -0,0 +1,71 @@
+#pragma once
+#include <Urho3D/Container/Vector.h>
+#include <Urho3D/Core/WorkQueue.h>
+#include <Urho3D/Math/Ray.h>
+#include <Urho3D/Physics/PhysicsWorld.h>
+
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+class btCollisionObject;
+
+// One ray or sphere cast
+struct CastQuery
+{
+	Ray ray;
+	float maxDistance;
+	// 0 for a ray, otherwise the radius of the swept sphere
+	float radius;
+	unsigned collisionMask;
+};
+
+// Answers many ray/sphere casts per frame across the WorkQueue threads.
+// Bullet's own rayTest walks the broadphase tree with a shared stack and can't be
+// called from several threads, so Cast first takes a read-only snapshot of every
+// collision object's bounds and filter group, and bins it into a hashed uniform grid.
+// Workers walk each ray through the grid cells it crosses, nearest first, and call
+// Bullet's static per-object narrowphase, which touches no shared state, only for the
+// objects in those cells. Objects too big for the grid (the floor) are tested by every ray.
+// Cast returns only when all queries are done, so the world can't step underneath it.
+class BatchRaycaster
+{
+public:
+	BatchRaycaster() {};
+
+	// Fewest queries handed to each work item; larger batches are split evenly over the queue's threads
+	unsigned batchSize = 64;
+	// Edge length of a grid cell. About the size of the common objects works best.
+	float cellSize = 4.0f;
+
+	// Fill hits with one result per query. A miss has a null body_.
+	void Cast(WorkQueue* pQueue, PhysicsWorld* pWorld, const PODVector<CastQuery>& queries, PODVector<PhysicsRaycastResult>& hits);
+
+private:
+	struct SnapshotObject
+	{
+		btCollisionObject* pObject;
+		Vector3 min;
+		Vector3 max;
+		unsigned group;
+	};
+
+	// Bin the snapshot into the grid, growing each object's bounds by pad (the widest sphere)
+	void BuildGrid(float pad);
+	static void CastWork(const WorkItem* pItem, unsigned threadIndex);
+	void CastOne(const CastQuery& query, PhysicsRaycastResult& hit) const;
+	// Narrowphase against one snapshot object, keeping the hit if it is the closest so far
+	void TestObject(const CastQuery& query, const SnapshotObject& s, float& closest, PhysicsRaycastResult& hit) const;
+	int ToCell(float v) const { return (int)floorf(v * invCellSize); }
+	unsigned HashCell(int x, int y, int z) const;
+
+	PODVector<SnapshotObject> snapshot;
+	// cellStart[h]..cellStart[h + 1] indexes into cellEntries (snapshot indices) for hash bucket h
+	PODVector<unsigned> cellStart;
+	PODVector<unsigned> cellEntries;
+	// Snapshot indices of objects spanning too many cells to bin
+	PODVector<unsigned> largeObjects;
+	float invCellSize = 1.0f;
+	unsigned tableMask = 0;
+	const CastQuery* pQueries = nullptr;
+	PhysicsRaycastResult* pHits = nullptr;
+};
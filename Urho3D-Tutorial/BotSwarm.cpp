@@ -0,0 +1,97 @@
+#include <Urho3D/Graphics/Graphics.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Network/Connection.h>
+#include <Urho3D/Physics/PhysicsWorld.h>
+#include <Urho3D/Resource/ResourceCache.h>
+#include "BotSwarm.h"
+#include "Character.h"
+#include "DeadReckoning.h"
+#include "NetworkProtocol.h"
+
+void BotSwarm::Start(const String& address, unsigned short port, unsigned numBots)
+{
+	Stop();
+	this->address = address;
+	this->port = port;
+
+	for (unsigned i = 0; i < numBots; i++)
+	{
+		Bot bot;
+		bot.context = new Context();
+		// Everything the server replicates, so scene updates parse. No Graphics subsystem
+		// and no resource directories: models and materials just fail to load.
+		bot.context->RegisterSubsystem(new ResourceCache(bot.context));
+		RegisterSceneLibrary(bot.context);
+		RegisterGraphicsLibrary(bot.context);
+		RegisterPhysicsLibrary(bot.context);
+		DeadReckoning::RegisterObject(bot.context);
+		bot.pNetwork = new Network(bot.context);
+		bot.context->RegisterSubsystem(bot.pNetwork);
+		// The server tells every new player its ball; accept it quietly
+		bot.pNetwork->RegisterRemoteEvent(E_CLIENTOBJECTAUTHORITY);
+
+		bot.scene = new Scene(bot.context);
+		bot.ready = false;
+		bot.phase = 360.0f * i / numBots;
+		bot.pNetwork->Connect(address, port, bot.scene);
+		bots.Push(bot);
+	}
+	Log::Write(LOG_INFO, "Started " + String(numBots) + " bots against " + address + ":" + String(port));
+}
+
+void BotSwarm::Update(float timeStep)
+{
+	time += timeStep;
+	for (unsigned i = 0; i < bots.Size(); i++)
+	{
+		Bot& bot = bots[i];
+		bot.pNetwork->Update(timeStep);
+
+		Connection* pServer = bot.pNetwork->GetServerConnection();
+		if (pServer && pServer->IsConnected())
+		{
+			// Same handshake as the menu's start game button
+			if (!bot.ready && pServer->IsSceneLoaded())
+			{
+				VariantMap remoteEventData;
+				remoteEventData[PLAYER_ID] = 0;
+				pServer->SendRemoteEvent(E_CLIENTISREADY, true, remoteEventData);
+				bot.ready = true;
+			}
+			pServer->SetControls(ScriptControls(bot));
+		}
+
+		// Sends the controls once per network tick
+		bot.pNetwork->PostUpdate(timeStep);
+	}
+}
+
+void BotSwarm::Stop()
+{
+	for (unsigned i = 0; i < bots.Size(); i++)
+		bots[i].pNetwork->Disconnect();
+	bots.Clear();
+}
+
+unsigned BotSwarm::GetNumConnected() const
+{
+	unsigned numConnected = 0;
+	for (unsigned i = 0; i < bots.Size(); i++)
+	{
+		Connection* pServer = bots[i].pNetwork->GetServerConnection();
+		if (pServer && pServer->IsConnected())
+			numConnected++;
+	}
+	return numConnected;
+}
+
+Controls BotSwarm::ScriptControls(const Bot& bot) const
+{
+	// Roll forwards, turning a little, and every turnInterval swap between a left and a right curve
+	Controls controls;
+	controls.Set(CTRL_FORWARD, true);
+	bool left = ((int)((time + bot.phase) / turnInterval) & 1) != 0;
+	controls.Set(left ? CTRL_LEFT : CTRL_RIGHT, true);
+	controls.yaw_ = bot.phase + time * 20.0f;
+	return controls;
+}
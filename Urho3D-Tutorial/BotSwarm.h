@@ -0,0 +1,51 @@
+#pragma once
+#include <Urho3D/Container/Ptr.h>
+#include <Urho3D/Container/Vector.h>
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Network/Network.h>
+#include <Urho3D/Scene/Scene.h>
+
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+// Simulated players for load testing a server (-bots M). A Network subsystem
+// holds a single server connection, so every bot gets its own Context with its
+// own Network, ResourceCache and Scene. Nothing sends frame events into those
+// contexts; the host pumps each bot's Network::Update and PostUpdate from its
+// own update instead. Each bot connects, asks for a ball with E_CLIENTISREADY
+// and then drives it with scripted Controls, sent at the bot's network rate.
+class BotSwarm
+{
+public:
+	BotSwarm() {};
+	~BotSwarm() { Stop(); }
+
+	// Seconds between changes of a bot's steering
+	float turnInterval = 3.0f;
+
+	void Start(const String& address, unsigned short port, unsigned numBots);
+	void Update(float timeStep);
+	void Stop();
+
+	unsigned GetNumBots() const { return bots.Size(); }
+	unsigned GetNumConnected() const;
+
+private:
+	struct Bot
+	{
+		// Declared before the scene so the scene is destroyed first
+		SharedPtr<Context> context;
+		SharedPtr<Scene> scene;
+		Network* pNetwork;
+		bool ready;
+		// Start of this bot's scripted path, so the bots spread out
+		float phase;
+	};
+
+	Controls ScriptControls(const Bot& bot) const;
+
+	Vector<Bot> bots;
+	String address;
+	unsigned short port = 0;
+	float time = 0.0f;
+};
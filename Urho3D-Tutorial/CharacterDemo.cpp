@@ -21,6 +21,8 @@
 //
 
 #include <Urho3D/Core/CoreEvents.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Core/WorkQueue.h>
 #include <Urho3D/Core/ProcessUtils.h>
 #include <Urho3D/Engine/Engine.h>
 #include <Urho3D/Graphics/AnimatedModel.h>
@@ -45,11 +47,18 @@
 #include <Urho3D/Network/Connection.h>
 #include <Urho3D/Network/Network.h>
 #include <Urho3D/Network/NetworkEvents.h>
+#include <Urho3D/Network/NetworkPriority.h>
 #include <Urho3D/IO/Log.h>
 #include <Urho3D/Physics/PhysicsEvents.h>
 
 #include "Character.h"
 #include "CharacterDemo.h"
+#include "CollisionLayers.h"
+#include "CollisionProxy.h"
+#include "DeadReckoning.h"
+#include "FlockReplication.h"
+#include "NetworkEmulator.h"
+#include "NetworkStats.h"
 #include "Touch.h"
 #include "boids.h"
 #include "Missile.h"
@@ -59,31 +68,82 @@
 
 URHO3D_DEFINE_APPLICATION_MAIN(CharacterDemo)
 
-// Custom remote event we use to tell the client which object they control
-static const StringHash E_CLIENTOBJECTAUTHORITY("ClientObjectAuthority");
-
-// Identifier for the node ID parameter in the event data
-static const StringHash PLAYER_ID("IDENTITY");
-
-// Custom event on server, client has pressed button that it wants to start game
-static const StringHash E_CLIENTISREADY("ClientReadyToStart");
+// Updates per second for other players' balls; clients dead reckon between them
+static const float BALL_SEND_RATE = 10.0f;
 
 CharacterDemo::CharacterDemo(Context* context) :
     Sample(context),
     firstPerson_(false)
 {
+	DeadReckoning::RegisterObject(context);
 
 	//TUTORIAL: TODO
 }
 
 CharacterDemo::~CharacterDemo()
 {
+	// Drop shared collision geometry while Bullet is still around
+	CollisionGeometryCache::Clear();
+}
+
+void CharacterDemo::Setup()
+{
+	Sample::Setup();
+	ParseArguments();
+
+	if (headless || numBots)
+	{
+		engineParameters_["Headless"] = true;
+		engineParameters_["Sound"] = false;
+		engineParameters_["VSync"] = false;
+	}
+	// Start creates the worker threads instead, to the requested count
+	if (physicsThreads)
+		engineParameters_["WorkerThreads"] = false;
 }
 
 void CharacterDemo::Start()
 {
     // Execute base class startup
     Sample::Start();
+
+	// The main thread works through the queue too, so it counts as one of them
+	if (physicsThreads > 1)
+		GetSubsystem<WorkQueue>()->CreateThreads(physicsThreads - 1);
+
+	// Bot process: no scene of its own, just the bots' connections
+	if (numBots)
+	{
+		engine_->SetMaxFps(serverTickRate);
+		engine_->SetMaxInactiveFps(serverTickRate);
+		botSwarm.Start(botAddress, SERVER_PORT, numBots);
+		SubscribeToEvent(E_UPDATE, URHO3D_HANDLER(CharacterDemo, HandleBotUpdate));
+		return;
+	}
+
+	// Ahead of SubscribeToEvents, so its serialisation timing includes our own network update work
+	context_->RegisterSubsystem(new NetworkStats(context_));
+	if (!netStatsFile.Empty() && !GetSubsystem<NetworkStats>()->SetDumpFile(netStatsFile))
+		Log::Write(LOG_ERROR, "Could not open network stats file " + netStatsFile);
+
+	NetworkEmulator* emulator = new NetworkEmulator(context_);
+	context_->RegisterSubsystem(emulator);
+	emulator->SetSeed(emulatorSeed);
+	emulator->SetConditions(emulatedLatency, emulatedJitter, emulatedLoss, emulatedBandwidth);
+
+	if (headless)
+	{
+		logLoad = true;
+		// Nothing to draw, so the frame limiter alone sets the tick rate
+		engine_->SetMaxFps(serverTickRate);
+		engine_->SetMaxInactiveFps(serverTickRate);
+		CreateScene();
+		scene_->GetComponent<PhysicsWorld>()->SetFps(serverTickRate);
+		SubscribeToEvents();
+		StartServer();
+		return;
+	}
+
     if (touchEnabled_)
         touch_ = new Touch(context_, TOUCH_SENSITIVITY);
 
@@ -101,6 +161,63 @@ void CharacterDemo::Start()
 	//TUTORIAL: TODO
 }
 
+void CharacterDemo::ParseArguments()
+{
+	const Vector<String>& args = GetArguments();
+	for (unsigned i = 0; i < args.Size(); i++)
+	{
+		String arg = args[i].ToLower();
+		if (arg == "-flocksync")
+			flockLockstep = true;
+		else if (arg == "-headless")
+			headless = true;
+		else if (arg == "-loadlog")
+			logLoad = true;
+		else if (arg == "-netthreads")
+			threadedSnapshots = true;
+		// Options that take a value
+		if (i + 1 < args.Size())
+		{
+			if (arg == "-tickrate")
+				serverTickRate = Max(ToUInt(args[++i]), 1U);
+			else if (arg == "-bots")
+				numBots = ToUInt(args[++i]);
+			else if (arg == "-connect")
+				botAddress = args[++i];
+			else if (arg == "-netstats")
+				netStatsFile = args[++i];
+			else if (arg == "-netlatency")
+				emulatedLatency = ToInt(args[++i]);
+			else if (arg == "-netjitter")
+				emulatedJitter = ToInt(args[++i]);
+			else if (arg == "-netloss")
+				emulatedLoss = ToFloat(args[++i]) / 100.0f;
+			else if (arg == "-netbandwidth")
+				emulatedBandwidth = ToUInt(args[++i]);
+			else if (arg == "-netseed")
+				emulatorSeed = ToUInt(args[++i]);
+			else if (arg == "-physicsthreads")
+				physicsThreads = ToUInt(args[++i]);
+			else if (arg == "-flockinterest")
+				flockServer.interestRadius = ToFloat(args[++i]);
+			else if (arg == "-flockfar")
+				flockServer.farInterval = ToUInt(args[++i]);
+			else if (arg == "-flockcull")
+				flockServer.cullRadius = ToFloat(args[++i]);
+			else if (arg == "-rewind")
+				rewindSeconds = ToFloat(args[++i]);
+			else if (arg == "-rollback")
+				rollbackTicks = ToUInt(args[++i]);
+			else if (arg == "-inputsend")
+				inputBatch.sendInterval = Max(ToUInt(args[++i]), 1U);
+			else if (arg == "-inputredundancy")
+				inputBatch.redundancy = ToUInt(args[++i]);
+			else if (arg == "-inputdelay")
+				players.inputDelay = ToUInt(args[++i]);
+		}
+	}
+}
+
 void CharacterDemo::CreateScene()
 {
 	//so we can access resources
@@ -108,7 +225,7 @@ void CharacterDemo::CreateScene()
 	scene_ = new Scene(context_);
 	// Create scene subsystem components
 	scene_->CreateComponent<Octree>();
-	scene_->CreateComponent<PhysicsWorld>();
+	PhysicsWorld* physicsWorld = scene_->CreateComponent<PhysicsWorld>();
 
 	//Create camera node and component
 	cameraNode_ = new Node(context_);
@@ -116,64 +233,20 @@ void CharacterDemo::CreateScene()
 	cameraNode_->SetPosition(Vector3(0.0f, 5.0f, 0.0f));
 	camera->SetFarClip(300.0f);
 
-	GetSubsystem<Renderer>()->SetViewport(0, new Viewport(context_, scene_, camera));
-
-	// Create static scene content. First create a zone for ambient lighting and fog control
-	Node* zoneNode = scene_->CreateChild("Zone");
-	Zone* zone = zoneNode->CreateComponent<Zone>();
-	zone->SetAmbientColor(Color(0.15f, 0.15f, 0.15f));
-	zone->SetFogColor(Color(0.5f, 0.5f, 0.7f));
-	zone->SetFogStart(100.0f);
-	zone->SetFogEnd(300.0f);
-	zone->SetBoundingBox(BoundingBox(-1000.0f, 1000.0f));
-
-	// Create a directional light with cascaded shadow mapping
-	Node* lightNode = scene_->CreateChild("DirectionalLight");
-	lightNode->SetDirection(Vector3(0.3f, -0.5f, 0.425f));
-	Light* light = lightNode->CreateComponent<Light>();
-	light->SetLightType(LIGHT_DIRECTIONAL);
-	light->SetCastShadows(true);
-	light->SetShadowBias(BiasParameters(0.00025f, 0.5f));
-	light->SetShadowCascade(CascadeParameters(10.0f, 50.0f, 200.0f, 0.0f, 0.8f));
-	light->SetSpecularIntensity(0.5f);
-
-	// Create the floor object
-	Node* floorNode = scene_->CreateChild("Floor");
-	floorNode->SetPosition(Vector3(0.0f, -0.5f, 0.0f));
-	floorNode->SetScale(Vector3(200.0f, 1.0f, 200.0f));
-	StaticModel* object = floorNode->CreateComponent<StaticModel>();
-	object->SetModel(cache->GetResource<Model>("Models/Box.mdl"));
-	object->SetMaterial(cache -> GetResource<Material>("Materials/Stone.xml"));
-	RigidBody* body = floorNode->CreateComponent<RigidBody>();
-	// Use collision layer bit 2 to mark world scenery. This is what we will raycast against to prevent camera from going inside geometry
-	body->SetCollisionLayer(2);
-	CollisionShape* shape = floorNode->CreateComponent<CollisionShape>();
-	shape->SetBox(Vector3::ONE);
+	// No renderer on a dedicated server
+	Renderer* renderer = GetSubsystem<Renderer>();
+	if (renderer)
+		renderer->SetViewport(0, new Viewport(context_, scene_, camera));
+
+	// Static scenery is LOCAL on every peer; clients rebuild it from the seed the server sends
+	BuildScenery(Time::GetSystemTime());
 
 	// Initialise Boids
 	boids.Initialise(cache, scene_);
+	boids.SetBodyAvoidance(GetSubsystem<WorkQueue>(), physicsWorld);
 
 	// Initialise Missiles
-	missile.Initialise(cache, scene_);
-
-	// Create mushrooms of varying sizes
-	const unsigned NUM_MUSHROOMS = 60;
-	for (unsigned i = 0; i < NUM_MUSHROOMS; ++i)
-	{
-		Node* objectNode = scene_->CreateChild("Mushroom");
-		objectNode->SetPosition(Vector3(Random(180.0f) - 90.0f, 0.0f,
-			Random(180.0f) - 90.0f));
-		objectNode->SetRotation(Quaternion(0.0f, Random(360.0f), 0.0f));
-		objectNode->SetScale(2.0f + Random(5.0f));
-		StaticModel* object = objectNode->CreateComponent<StaticModel>();
-		object->SetModel(cache -> GetResource<Model>("Models/Mushroom.mdl"));
-		object->SetMaterial(cache -> GetResource<Material>("Materials/Mushroom.xml"));
-		object->SetCastShadows(true);
-		RigidBody* body = objectNode->CreateComponent<RigidBody>();
-		body->SetCollisionLayer(2);
-		CollisionShape* shape = objectNode -> CreateComponent<CollisionShape>();
-		shape->SetTriangleMesh(object->GetModel(), 0);
-	}
+	missile.Initialise(cache, scene_, contacts);
 
 	const unsigned NUM_BOXES = 100;
 	for (unsigned i = 0; i < NUM_BOXES; ++i)
@@ -190,7 +263,7 @@ void CharacterDemo::CreateScene()
 		object->SetMaterial(cache->GetResource<Material>("Materials/Stone.xml"));
 		object->SetCastShadows(true);
 		RigidBody* body = objectNode->CreateComponent<RigidBody>();
-		body->SetCollisionLayer(2);
+		CollisionMatrix::Apply(body, COLGROUP_DYNAMIC);
 		// Bigger boxes will be heavier and harder to move
 		body->SetMass(scale * 2.0f);
 		CollisionShape* shape = objectNode->CreateComponent<CollisionShape>();
@@ -201,6 +274,15 @@ void CharacterDemo::CreateScene()
 
 }
 
+void CharacterDemo::BuildScenery(unsigned seed)
+{
+	scenery.Generate(scene_, GetSubsystem<ResourceCache>(), seed);
+
+	// Distance field of the scenery for the boids to steer around
+	sceneryField.Build(scene_, BoundingBox(Vector3(-100.0f, -1.0f, -100.0f), Vector3(100.0f, 60.0f, 100.0f)), 2.0f);
+	boids.SetObstacles(&sceneryField);
+}
+
 void CharacterDemo::CreateCharacter()
 {
 	//TUTORIAL: TODO
@@ -220,11 +302,21 @@ void CharacterDemo::SubscribeToEvents()
 	SubscribeToEvent(E_CLIENTCONNECTED, URHO3D_HANDLER(CharacterDemo, HandleClientConnected));
 	SubscribeToEvent(E_CLIENTDISCONNECTED, URHO3D_HANDLER(CharacterDemo, HandleClientDisconnected));
 	SubscribeToEvent(E_PHYSICSPRESTEP, URHO3D_HANDLER(CharacterDemo, HandlePhysicsPreStep));
+	SubscribeToEvent(E_PHYSICSPOSTSTEP, URHO3D_HANDLER(CharacterDemo, HandlePhysicsPostStep));
+	SubscribeToEvent(E_NETWORKUPDATE, URHO3D_HANDLER(CharacterDemo, HandleNetworkUpdate));
+	SubscribeToEvent(E_NETWORKMESSAGE, URHO3D_HANDLER(CharacterDemo, HandleNetworkMessage));
 	SubscribeToEvent(E_CLIENTSCENELOADED, URHO3D_HANDLER(CharacterDemo, HandleClientFinishedLoading));
 	SubscribeToEvent(E_CLIENTISREADY, URHO3D_HANDLER(CharacterDemo, HandleClientToServerReadyToStart));
 	GetSubsystem<Network>()->RegisterRemoteEvent(E_CLIENTISREADY);
 	SubscribeToEvent(E_CLIENTOBJECTAUTHORITY, URHO3D_HANDLER(CharacterDemo, HandleServerToClientObjectID));
 	GetSubsystem<Network>()->RegisterRemoteEvent(E_CLIENTOBJECTAUTHORITY);
+	// Rollback runs here every frame; the load log only adds its timing
+	SubscribeToEvent(E_BEGINFRAME, URHO3D_HANDLER(CharacterDemo, HandleBeginFrame));
+	if (logLoad)
+	{
+		// End of Engine::Update, before the frame limiter sleeps
+		SubscribeToEvent(E_POSTRENDERUPDATE, URHO3D_HANDLER(CharacterDemo, HandlePostRenderUpdate));
+	}
 	//TUTORIAL: TODO
 }
 
@@ -234,7 +326,8 @@ void CharacterDemo::HandleUpdate(StringHash eventType, VariantMap& eventData)
 	// Take the frame time step, which is stored as a float
 	float timeStep = eventData[P_TIMESTEP].GetFloat();
 	// Do not move if the UI has a focused element (the console)
-	if (GetSubsystem<UI>()->GetFocusElement()) return;
+	UI* ui = GetSubsystem<UI>();
+	if (ui && ui->GetFocusElement()) return;
 	Input* input = GetSubsystem<Input>();
 	// Movement speed as world units per second
 	const float MOVE_SPEED = 20.0f;
@@ -275,15 +368,40 @@ void CharacterDemo::HandleUpdate(StringHash eventType, VariantMap& eventData)
 		if (ballNode)
 		{
 			const float CAMERA_DISTANCE = 5.0f;
-			cameraNode_->SetPosition(ballNode->GetPosition() + cameraNode_->GetRotation()
-				* Vector3::BACK * CAMERA_DISTANCE);
+			// Pull the camera in front of scenery and boxes between it and the ball
+			Vector3 rayDir = cameraNode_->GetRotation() * Vector3::BACK;
+			float rayDistance = CAMERA_DISTANCE;
+			unsigned mask = CollisionMatrix::GetLayer(COLGROUP_STATIC) | CollisionMatrix::GetLayer(COLGROUP_DYNAMIC);
+			PhysicsRaycastResult result;
+			scene_->GetComponent<PhysicsWorld>()->RaycastSingle(result, Ray(ballNode->GetPosition(), rayDir), rayDistance, mask);
+			if (result.body_)
+				rayDistance = Max(result.distance_ - 0.5f, 0.0f);
+			cameraNode_->SetPosition(ballNode->GetPosition() + rayDir * rayDistance);
 		}
 	}
 
 
 	// Update Boids
 	boids.Update(timeStep);
-	missile.Update(timeStep);
+	// Replicated flock: draw it from the buffered snapshots
+	if (GetSubsystem<Network>()->GetServerConnection() && !flockLockstep)
+		flockClient.Update(timeStep, boids);
+
+	// Gather homing targets: every boid, then every player ball
+	homingTargets.Clear();
+	homingTargetIDs.Clear();
+	for (int i = 0; i < NumBoids; i++)
+	{
+		homingTargets.Push(boids.boidList[i].pRigidBody->GetPosition());
+		homingTargetIDs.Push(boids.boidList[i].pNode->GetID());
+	}
+	for (unsigned i = 0; i < players.Size(); i++)
+	{
+		homingTargets.Push(players[i].pNode->GetWorldPosition());
+		homingTargetIDs.Push(players[i].pNode->GetID());
+	}
+	missile.Update(timeStep, homingTargets.Size() ? &homingTargets[0] : nullptr,
+		homingTargetIDs.Size() ? &homingTargetIDs[0] : nullptr, homingTargets.Size());
 	//TUTORIAL: TODO
 }
 
@@ -334,11 +452,23 @@ void CharacterDemo::HandleClientConnected(StringHash eventType, VariantMap& even
 	Connection* newConnection = static_cast<Connection*>(eventData[P_CONNECTION].GetPtr());
 	newConnection->SetScene(scene_);
 
+	// The scenery isn't replicated, the client generates it from our seed
+	VectorBuffer seedMsg;
+	seedMsg.WriteUInt(scenery.seed);
+	NetworkEmulator::Send(newConnection, MSG_SCENERYSEED, true, true, seedMsg);
+	// The flock's nodes are local, so stream it while the client downloads the rest of the scene
+	if (!flockLockstep)
+		flockServer.BeginJoin(newConnection);
+
 }
 
 void CharacterDemo::HandleClientDisconnected(StringHash eventType, VariantMap& eventData)
 {
-	
+	using namespace ClientDisconnected;
+	Connection* connection = static_cast<Connection*>(eventData[P_CONNECTION].GetPtr());
+	flockServer.RemoveConnection(connection);
+	// Their ball goes with them
+	players.Remove(connection);
 }
 
 void CharacterDemo::HandleConnect(StringHash eventType, VariantMap& eventData)
@@ -365,11 +495,20 @@ void CharacterDemo::HandleDisconnect(StringHash eventType, VariantMap& eventData
 		serverConnection->Disconnect();
 		scene_->Clear(true, false);
 		clientObjectID_ = 0;
+		prediction.Reset();
+		inputBatch.Reset();
+		// Simulate our own flock again
+		boids.SetReplica(false);
+		flockSync.Reset();
 	}
 	// Running as a server, stop it
 	else if (network->IsServerRunning())
 	{
 		network->StopServer();
+		players.Clear();
+		rewind.Clear();
+		rollback.Clear();
+		flockServer.Reset();
 		scene_->Clear(true, false);
 	}
 }
@@ -395,35 +534,18 @@ Controls CharacterDemo::FromClientToServerControls()
 
 void CharacterDemo::ProcessClientControls()
 {
-	Network* network = GetSubsystem<Network>();
-	const Vector<SharedPtr<Connection> >& connections = network->GetClientConnections();
-	//Server: go through every client connected
-	for (unsigned i = 0; i < connections.Size(); ++i)
-	{
-		Connection* connection = connections[i];
-		// Get the object this connection is controlling
-		Node* ballNode = serverObjects_[connection];
-		// Client has no item connected
-		if (!ballNode) continue;
-		RigidBody* body = ballNode->GetComponent<RigidBody>();
-		// Get the last controls sent by the client
-		const Controls& controls = connection->GetControls();
-		// Torque is relative to the forward vector
-		Quaternion rotation(0.0f, controls.yaw_, 0.0f);
-		const float MOVE_TORQUE = 5.0f;
-		if (controls.buttons_ & CTRL_FORWARD)
-			body->ApplyTorque(rotation * Vector3::RIGHT * MOVE_TORQUE);
-		if (controls.buttons_ & CTRL_BACK)
-			body->ApplyTorque(rotation * Vector3::LEFT * MOVE_TORQUE);
-		if (controls.buttons_ & CTRL_LEFT)
-			body->ApplyTorque(rotation * Vector3::FORWARD * MOVE_TORQUE);
-		if (controls.buttons_ & CTRL_RIGHT)
-			body->ApplyTorque(rotation * Vector3::BACK * MOVE_TORQUE);
-	}
+	// Server: the last controls sent by every client with a ball
+	players.GatherControls(rollback.GetTick());
+	for (unsigned i = 0; i < players.Size(); ++i)
+		PlayerRegistry::ApplyControls(players[i].pRigidBody, players[i].controls);
 }
 
 void CharacterDemo::HandlePhysicsPreStep(StringHash eventType, VariantMap& eventData)
 {
+	// Rollback replays its own saved controls
+	if (rollback.IsResimulating())
+		return;
+
 	Network* network = GetSubsystem<Network>();
 	Connection* serverConnection = network->GetServerConnection();
 
@@ -431,7 +553,18 @@ void CharacterDemo::HandlePhysicsPreStep(StringHash eventType, VariantMap& event
 	if (serverConnection)
 	{
 		serverConnection->SetPosition(cameraNode_->GetPosition()); // send camera position
-		serverConnection->SetControls(FromClientToServerControls()); // send controls to server
+		Controls controls = FromClientToServerControls();
+		// Predict our own ball once the server has told us which one it is
+		if (!prediction.HasBody() && clientObjectID_)
+		{
+			Node* ballNode = scene_->GetNode(clientObjectID_);
+			if (ballNode)
+				prediction.SetBody(ballNode->GetComponent<RigidBody>());
+		}
+		// Send controls to server on the input channel instead of SetControls, which only carries the latest
+		unsigned inputSeq = inputBatch.Push(controls);
+		prediction.ApplyInput(controls, inputSeq);
+		inputBatch.Send(serverConnection);
 	}
 
 	// Server: Read Controls, Apply them if needed
@@ -439,17 +572,149 @@ void CharacterDemo::HandlePhysicsPreStep(StringHash eventType, VariantMap& event
 	{
 		ProcessClientControls(); // take data from clients, process it
 	}
+
+	// Lockstep flock: one fixed tick on the server and on every synced client
+	bool serverLockstep = network->IsServerRunning() && flockLockstep;
+	bool clientLockstep = serverConnection && flockSync.IsActive();
+	if (serverLockstep || clientLockstep)
+	{
+		using namespace PhysicsPreStep;
+		// A client steps in the server's ticks, whatever its own physics rate
+		if (serverLockstep)
+			flockSim.Step(flockSync.timeStep);
+		else
+			flockSync.Advance(flockSim, eventData[P_TIMESTEP].GetFloat());
+		boids.Place(flockSim.positions, flockSim.velocities);
+		if (serverLockstep)
+			flockSync.SendKeyframe(flockSim, network->GetClientConnections());
+		else
+			flockSync.CheckPending(serverConnection, flockSim);
+	}
+}
+
+void CharacterDemo::HandlePhysicsPostStep(StringHash eventType, VariantMap& eventData)
+{
+	if (rollback.IsResimulating())
+		return;
+
+	// Collect this step's contacts for bodies registered with ContactReport::SetReported
+	contacts.Gather(scene_->GetComponent<PhysicsWorld>());
+	missile.HandleContacts(contacts.GetPairs());
+
+	Network* network = GetSubsystem<Network>();
+	if (network->GetServerConnection())
+		prediction.RecordState();
+	// Server: where everything ended up this tick, for lag compensated hits
+	else if (network->IsServerRunning())
+	{
+		using namespace PhysicsPostStep;
+		rewind.BeginTick(eventData[P_TIMESTEP].GetFloat());
+		for (unsigned i = 0; i < NumBoids; i++)
+			rewind.Add(boids.boidList[i].pNode->GetID(), boids.boidList[i].pRigidBody->GetPosition());
+		for (unsigned i = 0; i < players.Size(); i++)
+			rewind.Add(players[i].pNode->GetID(), players[i].pNode->GetWorldPosition());
+		rollback.Save(players);
+	}
+}
+
+void CharacterDemo::HandleNetworkUpdate(StringHash eventType, VariantMap& eventData)
+{
+	// Server: one flock snapshot per client per network tick, unless clients simulate it themselves
+	Network* network = GetSubsystem<Network>();
+	if (network->IsServerRunning() && !flockLockstep)
+		flockServer.Send(boids, network->GetClientConnections());
+	// Server: each client's ball as of its newest input, for its prediction
+	if (network->IsServerRunning())
+		players.SendStates();
+}
+
+void CharacterDemo::HandleBeginFrame(StringHash eventType, VariantMap& eventData)
+{
+	if (logLoad)
+		loadLog.BeginFrame();
+
+	// Server: inputs that arrived after their step was played with a guess. The network has
+	// been read for this frame and no physics step is running, so replay the balls from there.
+	if (GetSubsystem<Network>()->IsServerRunning() && players.TakeLateInputs(lateInputs))
+	{
+		for (unsigned i = 0; i < lateInputs.Size(); i++)
+			rollback.CorrectInput(lateInputs[i]);
+		lateInputs.Clear();
+		rollback.Resimulate(scene_, players, rewind);
+	}
+}
+
+void CharacterDemo::HandlePostRenderUpdate(StringHash eventType, VariantMap& eventData)
+{
+	Network* network = GetSubsystem<Network>();
+	if (network->IsServerRunning())
+		loadLog.EndFrame(GetSubsystem<NetworkStats>());
+}
+
+void CharacterDemo::HandleBotUpdate(StringHash eventType, VariantMap& eventData)
+{
+	using namespace Update;
+	botSwarm.Update(eventData[P_TIMESTEP].GetFloat());
+}
+
+void CharacterDemo::HandleNetworkMessage(StringHash eventType, VariantMap& eventData)
+{
+	using namespace NetworkMessage;
+	Connection* connection = static_cast<Connection*>(eventData[P_CONNECTION].GetPtr());
+	int msgID = eventData[P_MESSAGEID].GetInt();
+	const PODVector<unsigned char>& data = eventData[P_DATA].GetBuffer();
+	MemoryBuffer msg(data);
+
+	if (msgID == MSG_FLOCKSNAPSHOT)
+		flockClient.HandleSnapshot(connection, msg);
+	else if (msgID == MSG_FLOCKJOIN)
+		flockClient.HandleJoinChunk(msg);
+	else if (msgID == MSG_FLOCKACK)
+		flockServer.HandleAck(connection, msg);
+	else if (msgID == MSG_FLOCKSETUP)
+	{
+		flockSync.HandleSetup(msg, flockSim);
+		boids.Place(flockSim.positions, flockSim.velocities);
+	}
+	else if (msgID == MSG_FLOCKKEYFRAME)
+		flockSync.HandleKeyframe(connection, msg, flockSim);
+	else if (msgID == MSG_FLOCKRESYNC)
+		flockSync.HandleResync(connection, msg, flockSim);
+	else if (msgID == MSG_FLOCKCORRECTION)
+		flockSync.HandleCorrection(connection, msg, flockSim);
+	else if (msgID == MSG_PLAYERSTATE)
+		prediction.HandleState(msg);
+	else if (msgID == MSG_PLAYERINPUT)
+		players.HandleInput(connection, msg);
+	else if (msgID == MSG_SCENERYSEED)
+	{
+		unsigned seed = msg.ReadUInt();
+		if (seed != scenery.seed)
+			BuildScenery(seed);
+	}
 }
 
 void CharacterDemo::HandleClientFinishedLoading(StringHash eventType, VariantMap& eventData)
 {
 	printf("Client has finished loading up the scene from the server \n");
+	if (!GetSubsystem<Network>()->IsServerRunning())
+		return;
+
+	using namespace ClientSceneLoaded;
+	Connection* connection = static_cast<Connection*>(eventData[P_CONNECTION].GetPtr());
+	// Hand a lockstep client the flock to simulate from here on; a streamed flock started on connect
+	if (flockLockstep)
+		flockSync.SendSetup(connection, flockSim);
 }
 
 
 void CharacterDemo::CreateClientScene()
 {
-
+	// The server owns the flock; ours just shows what arrives on the flock channel
+	boids.SetReplica(true);
+	flockClient.Reset();
+	prediction.Reset();
+	inputBatch.Reset();
 }
 
 void CharacterDemo::CreateServerScene()
@@ -470,7 +735,8 @@ void CharacterDemo::HandleClientToServerReadyToStart(StringHash eventType, Varia
 	Connection* newConnection = static_cast<Connection*>(eventData[P_CONNECTION].GetPtr());
 	// Create a controllable object for that client
 	Node* newObject = CreateControllableObject();
-	serverObjects_[newConnection] = newObject;
+	newObject->SetOwner(newConnection);
+	players.Add(newConnection, newObject);
 	// Finally send the object's node ID using a remote event
 	VariantMap remoteEventData;
 	remoteEventData[PLAYER_ID] = newObject->GetID();
@@ -506,6 +772,7 @@ Node* CharacterDemo::CreateControllableObject()
 
 	// Create the physics components
 	RigidBody* body = ballNode->CreateComponent<RigidBody>();
+	CollisionMatrix::Apply(body, COLGROUP_PLAYERS);
 	body->SetMass(1.0f);
 	body->SetFriction(1.0f);
 	// motion damping so that the ball can not accelerate limitlessly
@@ -513,6 +780,17 @@ Node* CharacterDemo::CreateControllableObject()
 	body->SetAngularDamping(0.25f);
 	CollisionShape* shape = ballNode->CreateComponent<CollisionShape>();
 	shape->SetSphere(1.0f);
+
+	// Interest management for generic replication: sent at BALL_SEND_RATE, falling off with
+	// distance from each client's reported position down to a fifth of that. The owner always gets full rate.
+	float basePriority = Min(100.0f * BALL_SEND_RATE / GetSubsystem<Network>()->GetUpdateFps(), 100.0f);
+	NetworkPriority* priority = ballNode->CreateComponent<NetworkPriority>();
+	priority->SetBasePriority(basePriority);
+	priority->SetDistanceFactor(1.0f);
+	priority->SetMinPriority(basePriority / 5.0f);
+	priority->SetAlwaysUpdateOwner(true);
+	// Smooths the low rate updates on clients
+	ballNode->CreateComponent<DeadReckoning>();
 	return ballNode;
 }
 
@@ -520,12 +798,33 @@ Node* CharacterDemo::CreateControllableObject()
 void CharacterDemo::HandleStartServer(StringHash eventType, VariantMap& eventData)
 {
 	Log::WriteRaw("(HandleStartServer called) Server is started!");
+	StartServer();
+
+	// Makes menu disappear
+	menuVisible = !menuVisible;
+}
 
+void CharacterDemo::StartServer()
+{
 	Network* network = GetSubsystem<Network>();
 	network->StartServer(SERVER_PORT);
+	flockServer.pWorkQueue = threadedSnapshots ? GetSubsystem<WorkQueue>() : nullptr;
 
-	// Makes menu disappear
-	menuVisible = !menuVisible;
+	// Fixed size from here on: one slot per boid and player ball per physics tick
+	rewind.Configure(rewindSeconds, scene_->GetComponent<PhysicsWorld>()->GetFps(), NumBoids + MaxRewindPlayers);
+	Log::WriteRaw("Rewind buffer: " + String(rewind.GetMemoryUse() / 1024) + " KB \n");
+	rollback.Configure(rollbackTicks, MaxRewindPlayers);
+	Log::WriteRaw("Rollback buffer: " + String(rollback.GetMemoryUse() / 1024) + " KB \n");
+
+	// Lockstep flock: restart it from a fresh seed, stepped by flockSim instead of Bullet
+	if (flockLockstep)
+	{
+		flockSync.seed = Time::GetSystemTime();
+		flockSync.timeStep = 1.0f / scene_->GetComponent<PhysicsWorld>()->GetFps();
+		flockSim.Reset(flockSync.seed);
+		boids.SetReplica(true);
+		boids.Place(flockSim.positions, flockSim.velocities);
+	}
 }
 
 void CharacterDemo::HandleQuit(StringHash eventType, VariantMap& eventData)
@@ -535,6 +834,12 @@ void CharacterDemo::HandleQuit(StringHash eventType, VariantMap& eventData)
 
 void CharacterDemo::HandlePostUpdate(StringHash eventType, VariantMap& eventData)
 {
+	// Snapshots serialised on worker threads since the last network update, while this frame's tick ran
+	flockServer.Flush();
+
+	// No menu or cursor on a dedicated server
+	if (headless)
+		return;
 	UI* ui = GetSubsystem<UI>();
 	Input* input = GetSubsystem<Input>();
 	ui->GetCursor()->SetVisible(menuVisible);
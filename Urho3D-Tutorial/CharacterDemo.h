@@ -22,7 +22,17 @@
 
 #pragma once
 #include "boids.h"
+#include "BotSwarm.h"
+#include "ClientPrediction.h"
 #include "Missile.h"
+#include "ContactReport.h"
+#include "PlayerRegistry.h"
+#include "RewindBuffer.h"
+#include "Rollback.h"
+#include "Scenery.h"
+#include "ServerLoadLog.h"
+#include "FlockReplication.h"
+#include "FlockSync.h"
 #include "Sample.h"
 #include <Urho3D/UI/LineEdit.h>
 #include <Urho3D/UI/Button.h>
@@ -90,6 +100,8 @@ public:
 		lineEdit->SetStyleAuto();
 		return lineEdit;
 	}
+    /// Setup before engine initialization. Reads the command line and configures a dedicated server.
+    virtual void Setup();
     /// Setup after engine initialization and before running the main loop.
     virtual void Start();
 
@@ -141,8 +153,12 @@ protected:
     }
 
 private:
+    /// Read command line options.
+    void ParseArguments();
     /// Create static scene content.
     void CreateScene();
+	// Build the seeded scenery and the boids' distance field of it
+	void BuildScenery(unsigned seed);
     /// Create controllable character.
     void CreateCharacter();
     /// Construct an instruction text to the UI.
@@ -162,6 +178,8 @@ private:
 	void HandleDisconnect(StringHash eventType, VariantMap& eventData);
 	// Server Start Handler
 	void HandleStartServer(StringHash eventType, VariantMap& eventData);
+	// Listen on SERVER_PORT and set up the server side of the game
+	void StartServer();
 	// Quit Handler
 	void HandleQuit(StringHash eventType, VariantMap& eventData);
 	// Connection Handler
@@ -173,13 +191,34 @@ private:
 	Controls FromClientToServerControls();
 	void ProcessClientControls();
 	void HandlePhysicsPreStep(StringHash eventType, VariantMap& eventData);
+	void HandlePhysicsPostStep(StringHash eventType, VariantMap& eventData);
+	// Send game-specific replication when the network update goes out
+	void HandleNetworkUpdate(StringHash eventType, VariantMap& eventData);
+	// Dispatch the game's own network messages (NetworkProtocol.h)
+	void HandleNetworkMessage(StringHash eventType, VariantMap& eventData);
+	// Server rollback of late inputs, and the load log's (-loadlog) frame timing
+	void HandleBeginFrame(StringHash eventType, VariantMap& eventData);
+	void HandlePostRenderUpdate(StringHash eventType, VariantMap& eventData);
+	// Bot process (-bots M): pump the bots' networks
+	void HandleBotUpdate(StringHash eventType, VariantMap& eventData);
 	void HandleClientFinishedLoading(StringHash eventType, VariantMap& eventData);
 	void CreateClientScene();
 	void CreateServerScene();
 
 	Node* CreateControllableObject(); // Server: Create a controllable ball
 	unsigned clientObjectID_ = 0; // Client: ID of own object
-	HashMap<Connection*, WeakPtr<Node>> serverObjects_; // Server Client/Object HashMap
+	PlayerRegistry players; // Server: each client's ball and controls, in dense slots
+	ClientPrediction prediction; // Client: own ball moved by local input, corrected by the server
+	InputBatcher inputBatch; // Client: numbered inputs to the server, several per packet
+	// Server: recent boid and ball positions for judging hits as the shooter saw them.
+	// Holds -rewind seconds of ticks (default 1) for the flock and up to MaxRewindPlayers balls.
+	RewindBuffer rewind;
+	float rewindSeconds = 1.0f;
+	static const unsigned MaxRewindPlayers = 32;
+	// Server: per tick ball states and controls, so late inputs can be replayed (-rollback ticks, default 16)
+	Rollback rollback;
+	unsigned rollbackTicks = 16;
+	PODVector<LateInput> lateInputs;
 
 	// Handle remote event from server to Client to share controlled object node ID.
 	void HandleServerToClientObjectID(StringHash eventType, VariantMap& eventData);
@@ -198,6 +237,51 @@ private:
 
 	BoidSet boids;
 	MissileSet missile;
+	// Flock channel: the server sends, clients receive. Interest management is tuned with
+	// -flockinterest radius, -flockfar snapshots (0 drops far boids) and -flockcull radius.
+	FlockServer flockServer;
+	FlockClient flockClient;
+	// Lockstep flock (-flocksync on the server): everyone simulates, the server only checks
+	bool flockLockstep = false;
+	DeterministicFlock flockSim;
+	FlockSync flockSync;
+	// Positions missiles can home on and their node IDs, rebuilt every update
+	PODVector<Vector3> homingTargets;
+	PODVector<unsigned> homingTargetIDs;
+	// Pairs touching reported bodies, rebuilt every physics step
+	ContactReport contacts;
+	// Static scenery, generated locally on every peer from the server's seed
+	Scenery scenery;
+	// Static scenery baked for boid obstacle avoidance
+	SignedDistanceField sceneryField;
 
 	bool missileActive = false;
+
+	// Dedicated server (-headless): no graphics, audio, UI or touch; serves on SERVER_PORT at a fixed tick
+	bool headless = false;
+	// Frames and physics steps per second for a dedicated server, from -tickrate N
+	unsigned serverTickRate = 60;
+	// Load testing: -bots M runs M headless bot clients against -connect address instead of the game
+	unsigned numBots = 0;
+	String botAddress = "localhost";
+	BotSwarm botSwarm;
+	// Log server tick, replication and bandwidth figures; -loadlog, always on for a dedicated server
+	bool logLoad = false;
+	ServerLoadLog loadLog;
+	// NetworkStats writes a JSON line per second here, from -netstats file
+	String netStatsFile;
+	// Emulated network conditions for outgoing traffic: -netlatency ms, -netjitter ms,
+	// -netloss percent, -netbandwidth bytes per second and -netseed for repeatable runs.
+	// Latency and loss apply to all traffic; jitter and bandwidth to the game's own messages only.
+	int emulatedLatency = 0;
+	int emulatedJitter = 0;
+	float emulatedLoss = 0.0f;
+	unsigned emulatedBandwidth = 0;
+	unsigned emulatorSeed = 1;
+	// Serialise each client's flock snapshot on the WorkQueue threads, from -netthreads
+	bool threadedSnapshots = false;
+	// Threads, the main one included, for the WorkQueue that runs the boids' batched look-ahead
+	// raycasts, from -physicsthreads N. 0 keeps the engine's one per core. The Bullet 2.86 in
+	// Urho3D 1.7 has no multithreaded world or solver, so the step itself stays on the main thread.
+	unsigned physicsThreads = 0;
 };
@@ -0,0 +1,94 @@
+#include <Urho3D/Scene/Node.h>
+#include "ClientPrediction.h"
+#include "DeadReckoning.h"
+#include "PlayerRegistry.h"
+
+void ClientPrediction::Reset()
+{
+	body.Reset();
+	seq = 0;
+	ackedSeq = 0;
+	for (unsigned i = 0; i < PredictionHistory; i++)
+		history[i].seq = 0;
+}
+
+void ClientPrediction::SetBody(RigidBody* pBody)
+{
+	Reset();
+	if (!pBody)
+		return;
+	body = pBody;
+
+	// Ours to simulate: no smoothing towards the server, and no network transform or velocity
+	Node* pNode = pBody->GetNode();
+	DeadReckoning* pReckoning = pNode->GetComponent<DeadReckoning>();
+	if (pReckoning)
+		pReckoning->SetEnabled(false);
+	pNode->SetInterceptNetworkUpdate("Network Position", true);
+	pNode->SetInterceptNetworkUpdate("Network Rotation", true);
+	pBody->SetInterceptNetworkUpdate("Linear Velocity", true);
+	pBody->SetInterceptNetworkUpdate("Network Angular Velocity", true);
+	pBody->SetKinematic(false);
+}
+
+void ClientPrediction::ApplyInput(const Controls& controls, unsigned inputSeq)
+{
+	RigidBody* pRigidBody = body;
+	if (!pRigidBody)
+		return;
+	seq = inputSeq;
+	PlayerRegistry::ApplyControls(pRigidBody, controls);
+}
+
+void ClientPrediction::RecordState()
+{
+	RigidBody* pRigidBody = body;
+	if (!pRigidBody || !seq)
+		return;
+	Entry& entry = history[seq % PredictionHistory];
+	entry.seq = seq;
+	entry.position = pRigidBody->GetPosition();
+	entry.rotation = pRigidBody->GetRotation();
+	entry.linearVelocity = pRigidBody->GetLinearVelocity();
+	entry.angularVelocity = pRigidBody->GetAngularVelocity();
+}
+
+void ClientPrediction::HandleState(MemoryBuffer& msg)
+{
+	unsigned stateSeq = msg.ReadUInt();
+	Vector3 position = msg.ReadVector3();
+	Quaternion rotation = msg.ReadQuaternion();
+	Vector3 linearVelocity = msg.ReadVector3();
+	Vector3 angularVelocity = msg.ReadVector3();
+
+	// Stale, or for an input we no longer remember
+	RigidBody* pRigidBody = body;
+	const Entry& predicted = history[stateSeq % PredictionHistory];
+	if (!pRigidBody || stateSeq <= ackedSeq || predicted.seq != stateSeq)
+		return;
+	ackedSeq = stateSeq;
+
+	Vector3 positionError = position - predicted.position;
+	float factor = positionError.Length() > snapDistance ? 1.0f : correctionRate;
+	Vector3 dp = positionError * factor;
+	Vector3 dv = (linearVelocity - predicted.linearVelocity) * factor;
+	Vector3 dw = (angularVelocity - predicted.angularVelocity) * factor;
+	Quaternion dq = Quaternion::IDENTITY.Slerp(rotation * predicted.rotation.Inverse(), factor);
+
+	pRigidBody->SetPosition(pRigidBody->GetPosition() + dp);
+	pRigidBody->SetRotation((dq * pRigidBody->GetRotation()).Normalized());
+	pRigidBody->SetLinearVelocity(pRigidBody->GetLinearVelocity() + dv);
+	pRigidBody->SetAngularVelocity(pRigidBody->GetAngularVelocity() + dw);
+
+	// Predictions made since then carry the same error, which is now accounted for
+	for (unsigned s = stateSeq; s <= seq && seq - s < PredictionHistory; s++)
+	{
+		Entry& entry = history[s % PredictionHistory];
+		if (entry.seq != s)
+			continue;
+		entry.position += dp;
+		entry.rotation = (dq * entry.rotation).Normalized();
+		entry.linearVelocity += dv;
+		entry.angularVelocity += dw;
+	}
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <Urho3D/Input/Controls.h>
+#include <Urho3D/IO/MemoryBuffer.h>
+#include <Urho3D/Physics/RigidBody.h>
+
+namespace Urho3D
+{
+	// Physics steps of inputs and predicted states kept for reconciliation
+	const unsigned PredictionHistory = 128;
+}
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+// Client side prediction of the player's own ball. The client applies its
+// controls to its own copy of the ball every physics step, as the server will,
+// instead of waiting a round trip to see them. Every input is numbered (InputBatcher); the
+// server answers with its state of the ball after the newest input it has
+// applied (MSG_PLAYERSTATE). The difference from what we predicted for that
+// input is the prediction error. It is added to the live ball, in full if it is
+// larger than snapDistance and a fraction at a time otherwise, and to the newer
+// predictions so that later answers don't correct it twice. The world can only
+// be stepped as a whole, so inputs are not replayed; over the few steps of a
+// round trip the error carries forward almost unchanged.
+class ClientPrediction
+{
+public:
+	ClientPrediction() {};
+
+	// Position errors beyond this are corrected at once
+	float snapDistance = 2.0f;
+	// Fraction of a smaller error corrected per server state
+	float correctionRate = 0.3f;
+
+	void Reset();
+	// Predict this ball from now on. Takes the node's transform and velocities off the
+	// network (they arrive as MSG_PLAYERSTATE instead) and makes the body dynamic again.
+	void SetBody(RigidBody* pBody);
+	bool HasBody() const { return body.NotNull(); }
+
+	// Before a physics step: apply the controls numbered inputSeq to the ball
+	void ApplyInput(const Controls& controls, unsigned inputSeq);
+	// After the physics step: remember the state predicted for the input
+	void RecordState();
+	// Reconcile with the server's state for one of our inputs
+	void HandleState(MemoryBuffer& msg);
+
+private:
+	struct Entry
+	{
+		unsigned seq;
+		Vector3 position;
+		Quaternion rotation;
+		Vector3 linearVelocity;
+		Vector3 angularVelocity;
+	};
+
+	// Weak: the ball goes with a scene reload
+	WeakPtr<RigidBody> body;
+	unsigned seq = 0;
+	unsigned ackedSeq = 0;
+	Entry history[PredictionHistory];
+};
@@ -0,0 +1,73 @@
+#include "CollisionGeometryCache.h"
+
+HashMap<ModelLod, ProxyFit> CollisionGeometryCache::fits;
+HashMap<ModelLod, SharedPtr<CollisionGeometryData> > CollisionGeometryCache::retained;
+
+const ProxyFit& CollisionGeometryCache::GetFit(Model* pModel, unsigned lodLevel)
+{
+	ModelLod key(pModel, lodLevel);
+	HashMap<ModelLod, ProxyFit>::ConstIterator i = fits.Find(key);
+	if (i != fits.End())
+		return i->second_;
+
+	const BoundingBox& box = pModel->GetBoundingBox();
+	Vector3 size = box.Size();
+	ProxyFit fit;
+	fit.centre = box.Center();
+	// Sphere that touches the box faces rather than enclosing the corners; a bit loose on thin models
+	fit.sphereDiameter = Max(Max(size.x_, size.y_), size.z_);
+
+	// Capsule along the longest axis, as wide as the larger of the other two
+	float longest = fit.sphereDiameter;
+	if (longest == size.y_)
+	{
+		fit.capsuleDiameter = Max(size.x_, size.z_);
+		fit.capsuleRotation = Quaternion::IDENTITY;
+	}
+	else if (longest == size.x_)
+	{
+		fit.capsuleDiameter = Max(size.y_, size.z_);
+		fit.capsuleRotation = Quaternion(90.0f, Vector3::FORWARD);
+	}
+	else
+	{
+		fit.capsuleDiameter = Max(size.x_, size.y_);
+		fit.capsuleRotation = Quaternion(90.0f, Vector3::RIGHT);
+	}
+	fit.capsuleHeight = Max(longest, fit.capsuleDiameter);
+
+	// Roughly equal extents: sphere. Clearly elongated: capsule. Otherwise the hull.
+	float shortest = Min(Min(size.x_, size.y_), size.z_);
+	if (shortest > longest * 0.75f)
+		fit.autoType = PROXY_SPHERE;
+	else if (fit.capsuleDiameter < longest * 0.6f)
+		fit.autoType = PROXY_CAPSULE;
+	else
+		fit.autoType = PROXY_CONVEXHULL;
+
+	return fits[key] = fit;
+}
+
+void CollisionGeometryCache::Retain(CollisionShape* pShape)
+{
+	PhysicsWorld* pWorld = pShape->GetPhysicsWorld();
+	Model* pModel = pShape->GetModel();
+	if (!pWorld || !pModel)
+		return;
+
+	ModelLod key(pModel, pShape->GetLodLevel());
+	if (retained.Contains(key))
+		return;
+
+	CollisionGeometryDataCache& worldCache = pShape->GetShapeType() == SHAPE_TRIANGLEMESH ?
+		pWorld->GetTriMeshCache() : pWorld->GetConvexCache();
+	CollisionGeometryDataCache::Iterator i = worldCache.Find(key);
+	if (i != worldCache.End())
+		retained[key] = i->second_;
+}
+
+void CollisionGeometryCache::Clear()
+{
+	retained.Clear();
+	fits.Clear();
+}
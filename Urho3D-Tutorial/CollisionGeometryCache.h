@@ -0,0 +1,55 @@
+#pragma once
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Container/Pair.h>
+#include <Urho3D/Graphics/Model.h>
+#include <Urho3D/Physics/CollisionShape.h>
+#include <Urho3D/Physics/PhysicsWorld.h>
+
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+enum ProxyShapeType
+{
+	PROXY_AUTO = 0,		// pick sphere, capsule or hull from the model's proportions
+	PROXY_TRIANGLEMESH,
+	PROXY_CONVEXHULL,
+	PROXY_CAPSULE,
+	PROXY_SPHERE
+};
+
+// Primitive fitted to a model's bounds, in model space
+struct ProxyFit
+{
+	ProxyShapeType autoType;
+	Vector3 centre;
+	float sphereDiameter;
+	float capsuleDiameter;
+	float capsuleHeight;
+	// Turns the Y-aligned capsule onto the model's long axis
+	Quaternion capsuleRotation;
+};
+
+typedef Pair<Model*, unsigned> ModelLod;
+
+// Collision geometry shared by every instance of a model, keyed by model and LOD.
+// Everything here is unscaled: each CollisionShape wraps the shared data with its
+// node's scale (btScaledBvhTriangleMeshShape for meshes, local scaling for hulls),
+// so a flock of randomly scaled cones still builds the cone's data once.
+// PhysicsWorld keeps its own mesh/hull cache but drops an entry as soon as the last
+// shape using it goes away; holding a reference here keeps it across respawns.
+class CollisionGeometryCache
+{
+public:
+	// Bounds-fitted primitives for the model
+	static const ProxyFit& GetFit(Model* pModel, unsigned lodLevel);
+	// Keep the mesh or hull data the shape just built alive for later instances
+	static void Retain(CollisionShape* pShape);
+	// Release everything, e.g. when the scene is cleared
+	static void Clear();
+
+	static unsigned GetNumRetained() { return retained.Size(); }
+
+private:
+	static HashMap<ModelLod, ProxyFit> fits;
+	static HashMap<ModelLod, SharedPtr<CollisionGeometryData> > retained;
+};
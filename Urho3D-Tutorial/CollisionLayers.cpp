@@ -0,0 +1,60 @@
+#include "CollisionLayers.h"
+
+// Bodies never put through the matrix keep Urho3D's default layer 1, so every
+// mask includes bit 1. Static scenery keeps layer 2. The boxes used to share it
+// and now have their own, so raycasts meant to hit both (the camera's) mask
+// COLGROUP_STATIC and COLGROUP_DYNAMIC.
+unsigned CollisionMatrix::layers[NumCollisionGroups] =
+{
+	2,		// COLGROUP_STATIC
+	4,		// COLGROUP_DYNAMIC
+	8,		// COLGROUP_BOIDS
+	16,		// COLGROUP_PROJECTILES
+	32		// COLGROUP_PLAYERS
+};
+
+unsigned CollisionMatrix::masks[NumCollisionGroups] =
+{
+	1 | 2 | 4 | 8 | 16 | 32,	// COLGROUP_STATIC
+	1 | 2 | 4 | 8 | 16 | 32,	// COLGROUP_DYNAMIC
+	1 | 2 | 4 | 16 | 32,		// COLGROUP_BOIDS: no boid-boid pairs
+	1 | 2 | 4 | 8 | 32,			// COLGROUP_PROJECTILES: no projectile-projectile pairs
+	1 | 2 | 4 | 8 | 16 | 32		// COLGROUP_PLAYERS
+};
+
+unsigned CollisionMatrix::GetLayer(CollisionGroup group)
+{
+	return layers[group];
+}
+
+unsigned CollisionMatrix::GetMask(CollisionGroup group)
+{
+	return masks[group];
+}
+
+void CollisionMatrix::SetCollides(CollisionGroup a, CollisionGroup b, bool collides)
+{
+	// Bullet only pairs two bodies when each one's mask contains the other's layer
+	if (collides)
+	{
+		masks[a] |= layers[b];
+		masks[b] |= layers[a];
+	}
+	else
+	{
+		masks[a] &= ~layers[b];
+		masks[b] &= ~layers[a];
+	}
+}
+
+bool CollisionMatrix::GetCollides(CollisionGroup a, CollisionGroup b)
+{
+	return (masks[a] & layers[b]) && (masks[b] & layers[a]);
+}
+
+void CollisionMatrix::Apply(RigidBody* pRigidBody, CollisionGroup group)
+{
+	pRigidBody->SetCollisionLayerAndMask(layers[group], masks[group]);
+	// Collision events are opt-in, see ContactReport
+	pRigidBody->SetCollisionEventMode(COLLISION_NEVER);
+}
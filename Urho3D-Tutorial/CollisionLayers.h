@@ -0,0 +1,36 @@
+#pragma once
+#include <Urho3D/Physics/RigidBody.h>
+
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+// Kinds of physics object in the scene. Each gets its own collision layer bit.
+enum CollisionGroup
+{
+	COLGROUP_STATIC = 0,	// floor and scenery
+	COLGROUP_DYNAMIC,		// pushable props (boxes)
+	COLGROUP_BOIDS,
+	COLGROUP_PROJECTILES,
+	COLGROUP_PLAYERS,
+	NumCollisionGroups
+};
+
+// Which groups generate contacts with which. Applied to a body at creation,
+// so changes only affect bodies created afterwards.
+// By default boids don't collide with boids (the flocking separation rule
+// already keeps them apart) and projectiles don't collide with projectiles.
+class CollisionMatrix
+{
+public:
+	static unsigned GetLayer(CollisionGroup group);
+	static unsigned GetMask(CollisionGroup group);
+	// Enable or disable contacts between two groups, both ways round
+	static void SetCollides(CollisionGroup a, CollisionGroup b, bool collides);
+	static bool GetCollides(CollisionGroup a, CollisionGroup b);
+	// Set the body's layer and mask for its group
+	static void Apply(RigidBody* pRigidBody, CollisionGroup group);
+
+private:
+	static unsigned layers[NumCollisionGroups];
+	static unsigned masks[NumCollisionGroups];
+};
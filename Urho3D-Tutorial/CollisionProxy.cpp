@@ -0,0 +1,34 @@
+#include "CollisionProxy.h"
+
+ProxyShapeType CollisionProxy::dynamicShape = PROXY_AUTO;
+
+void CollisionProxy::Apply(CollisionShape* pShape, Model* pModel, bool isDynamic, ProxyShapeType type, unsigned lodLevel)
+{
+	// Instance scale always comes from the node, never baked into the shape, so all instances share one mesh
+	if (!isDynamic)
+	{
+		pShape->SetTriangleMesh(pModel, lodLevel);
+		CollisionGeometryCache::Retain(pShape);
+		return;
+	}
+
+	if (type == PROXY_AUTO)
+		type = dynamicShape;
+	const ProxyFit& fit = CollisionGeometryCache::GetFit(pModel, lodLevel);
+	if (type == PROXY_AUTO || type == PROXY_TRIANGLEMESH)
+		type = fit.autoType;
+
+	switch (type)
+	{
+	case PROXY_SPHERE:
+		pShape->SetSphere(fit.sphereDiameter, fit.centre);
+		break;
+	case PROXY_CAPSULE:
+		pShape->SetCapsule(fit.capsuleDiameter, fit.capsuleHeight, fit.centre, fit.capsuleRotation);
+		break;
+	default:
+		pShape->SetConvexHull(pModel, lodLevel);
+		CollisionGeometryCache::Retain(pShape);
+		break;
+	}
+}
@@ -0,0 +1,14 @@
+#pragma once
+#include "CollisionGeometryCache.h"
+
+// Picks collision shapes for bodies. Triangle meshes are exact but Bullet
+// can't collide them properly (or cheaply) on moving bodies, so they are
+// kept for static geometry only and dynamic bodies get a fitted primitive.
+class CollisionProxy
+{
+public:
+	// Shape used for dynamic bodies when the caller doesn't ask for one
+	static ProxyShapeType dynamicShape;
+
+	static void Apply(CollisionShape* pShape, Model* pModel, bool isDynamic, ProxyShapeType type = PROXY_AUTO, unsigned lodLevel = 0);
+};
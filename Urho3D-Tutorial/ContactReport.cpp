@@ -0,0 +1,81 @@
+#include <Bullet/BulletCollision/CollisionDispatch/btCollisionObject.h>
+#include <Bullet/BulletCollision/NarrowPhaseCollision/btPersistentManifold.h>
+#include <Bullet/BulletDynamics/Dynamics/btDiscreteDynamicsWorld.h>
+#include <Bullet/BulletDynamics/Dynamics/btRigidBody.h>
+#include <Urho3D/Physics/PhysicsUtils.h>
+
+#include "ContactReport.h"
+
+// Marker stored in btCollisionObject's user index; Urho3D itself only uses the user pointer
+static const int REPORT_CONTACTS = 0x5250;
+
+void ContactReport::SetEventsEnabled(RigidBody* pRigidBody, bool enable)
+{
+	pRigidBody->SetCollisionEventMode(enable ? COLLISION_ACTIVE : COLLISION_NEVER);
+}
+
+void ContactReport::SetReported(RigidBody* pRigidBody, bool enable)
+{
+	WeakPtr<RigidBody> body(pRigidBody);
+	if (enable && !reported.Contains(body))
+		reported.Push(body);
+	else if (!enable)
+	{
+		reported.Remove(body);
+		if (pRigidBody->GetBody())
+			pRigidBody->GetBody()->setUserIndex(-1);
+	}
+}
+
+void ContactReport::Gather(PhysicsWorld* pWorld)
+{
+	pairs.Clear();
+	if (!pWorld || reported.Empty())
+		return;
+
+	// Mark the opted in bodies, dropping any that have been destroyed
+	for (unsigned i = 0; i < reported.Size();)
+	{
+		if (reported[i].Expired())
+		{
+			reported.Erase(i);
+			continue;
+		}
+		btRigidBody* pBody = reported[i]->GetBody();
+		if (pBody)
+			pBody->setUserIndex(REPORT_CONTACTS);
+		i++;
+	}
+
+	btDispatcher* pDispatcher = pWorld->GetWorld()->getDispatcher();
+	int numManifolds = pDispatcher->getNumManifolds();
+	for (int i = 0; i < numManifolds; i++)
+	{
+		btPersistentManifold* pManifold = pDispatcher->getManifoldByIndexInternal(i);
+		int numContacts = pManifold->getNumContacts();
+		if (!numContacts)
+			continue;
+		const btCollisionObject* pObjA = pManifold->getBody0();
+		const btCollisionObject* pObjB = pManifold->getBody1();
+		if (pObjA->getUserIndex() != REPORT_CONTACTS && pObjB->getUserIndex() != REPORT_CONTACTS)
+			continue;
+
+		ContactPair pair;
+		pair.pBodyA = static_cast<RigidBody*>(pObjA->getUserPointer());
+		pair.pBodyB = static_cast<RigidBody*>(pObjB->getUserPointer());
+		pair.impulse = 0.0f;
+		float deepest = M_INFINITY;
+		for (int j = 0; j < numContacts; j++)
+		{
+			const btManifoldPoint& point = pManifold->getContactPoint(j);
+			pair.impulse += point.getAppliedImpulse();
+			if (point.getDistance() < deepest)
+			{
+				deepest = point.getDistance();
+				pair.position = ToVector3(point.m_positionWorldOnB);
+				pair.normal = ToVector3(point.m_normalWorldOnB);
+			}
+		}
+		pairs.Push(pair);
+	}
+}
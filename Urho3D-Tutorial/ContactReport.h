@@ -0,0 +1,47 @@
+#pragma once
+#include <Urho3D/Container/Vector.h>
+#include <Urho3D/Physics/PhysicsWorld.h>
+#include <Urho3D/Physics/RigidBody.h>
+
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+// One touching pair from the last physics step
+struct ContactPair
+{
+	RigidBody* pBodyA;
+	RigidBody* pBodyB;
+	// Deepest contact point on B and the normal pointing from B to A
+	Vector3 position;
+	Vector3 normal;
+	// Summed impulse over the pair's contact points
+	float impulse;
+};
+
+// Collision reporting without per-contact VariantMaps.
+// Bodies don't send E_NODECOLLISION / E_PHYSICSCOLLISION unless they opt in with
+// SetEventsEnabled (CollisionMatrix::Apply turns them off at creation). Bodies that
+// only need to know what they touched can instead opt in to the report, which after
+// each step is one flat array of pairs read straight from Bullet's manifolds.
+class ContactReport
+{
+public:
+	ContactReport() {};
+
+	// Opt a body in or out of Urho3D's collision events
+	static void SetEventsEnabled(RigidBody* pRigidBody, bool enable);
+	// Opt a body in or out of the batched report. Pairs are reported if either body opted in.
+	void SetReported(RigidBody* pRigidBody, bool enable);
+
+	// Rebuild the pair array from the world's current manifolds. Call once per physics step.
+	// Does nothing while no body has opted in.
+	void Gather(PhysicsWorld* pWorld);
+
+	const PODVector<ContactPair>& GetPairs() const { return pairs; }
+
+private:
+	PODVector<ContactPair> pairs;
+	// Opted in bodies. Urho3D re-creates a btRigidBody on some changes (mass, shape), losing
+	// its user index, so Gather marks them again every step.
+	Vector<WeakPtr<RigidBody> > reported;
+};
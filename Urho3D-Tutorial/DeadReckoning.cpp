@@ -0,0 +1,133 @@
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/IO/MemoryBuffer.h>
+#include <Urho3D/Network/Network.h>
+#include <Urho3D/Physics/RigidBody.h>
+#include <Urho3D/Scene/Node.h>
+#include <Urho3D/Scene/SceneEvents.h>
+#include "DeadReckoning.h"
+
+void ReckoningBuffer::Push(float time, const Vector3& position, const Quaternion& rotation, const Vector3& velocity)
+{
+	newest = (newest + 1) % SIZE;
+	times[newest] = time;
+	positions[newest] = position;
+	rotations[newest] = rotation;
+	velocities[newest] = velocity;
+	if (count < SIZE)
+		count++;
+}
+
+bool ReckoningBuffer::Sample(float time, float maxExtrapolation, Vector3& position, Quaternion& rotation) const
+{
+	if (!count)
+		return false;
+
+	// Past the newest state: extrapolate along its velocity, for a limited time
+	if (time >= times[newest])
+	{
+		float ahead = Min(time - times[newest], maxExtrapolation);
+		position = positions[newest] + velocities[newest] * ahead;
+		rotation = rotations[newest];
+		return true;
+	}
+
+	// Otherwise find the two states either side of the time and blend them
+	unsigned later = newest;
+	for (unsigned i = 1; i < count; i++)
+	{
+		unsigned earlier = (newest + SIZE - i) % SIZE;
+		if (times[earlier] <= time)
+		{
+			float span = times[later] - times[earlier];
+			float t = span > 0.0f ? (time - times[earlier]) / span : 1.0f;
+			position = positions[earlier].Lerp(positions[later], t);
+			rotation = rotations[earlier].Slerp(rotations[later], t);
+			return true;
+		}
+		later = earlier;
+	}
+
+	// Older than everything we have
+	position = positions[later];
+	rotation = rotations[later];
+	return true;
+}
+
+DeadReckoning::DeadReckoning(Context* context) : LogicComponent(context)
+{
+	SetUpdateEventMask(USE_UPDATE);
+}
+
+void DeadReckoning::RegisterObject(Context* context)
+{
+	context->RegisterFactory<DeadReckoning>();
+
+	URHO3D_ATTRIBUTE("Interpolation Delay", float, interpolationDelay, 0.1f, AM_DEFAULT);
+	URHO3D_ATTRIBUTE("Max Extrapolation", float, maxExtrapolation, 0.25f, AM_DEFAULT);
+}
+
+void DeadReckoning::Start()
+{
+	// Only clients smooth; the server's transforms are authoritative
+	Network* pNetwork = GetSubsystem<Network>();
+	if (!pNetwork || !pNetwork->GetServerConnection())
+		return;
+
+	active = true;
+	node_->SetInterceptNetworkUpdate("Network Position", true);
+	node_->SetInterceptNetworkUpdate("Network Rotation", true);
+	SubscribeToEvent(node_, E_INTERCEPTNETWORKUPDATE, URHO3D_HANDLER(DeadReckoning, HandleInterceptNetworkUpdate));
+
+	RigidBody* pRigidBody = node_->GetComponent<RigidBody>();
+	if (pRigidBody)
+	{
+		pRigidBody->SetInterceptNetworkUpdate("Linear Velocity", true);
+		SubscribeToEvent(pRigidBody, E_INTERCEPTNETWORKUPDATE, URHO3D_HANDLER(DeadReckoning, HandleInterceptNetworkUpdate));
+		// Placed from the buffer, so local physics must not move it too
+		pRigidBody->SetKinematic(true);
+	}
+
+	pendingPosition = node_->GetPosition();
+	pendingRotation = node_->GetRotation();
+}
+
+void DeadReckoning::Update(float timeStep)
+{
+	if (!active)
+		return;
+
+	// The network has delivered this frame's attributes by now, so the state is complete
+	if (received)
+	{
+		buffer.Push(time, pendingPosition, pendingRotation, pendingVelocity);
+		received = false;
+	}
+
+	time += timeStep;
+	Vector3 position;
+	Quaternion rotation;
+	if (buffer.Sample(time - interpolationDelay, maxExtrapolation, position, rotation))
+	{
+		node_->SetPosition(position);
+		node_->SetRotation(rotation);
+	}
+}
+
+void DeadReckoning::HandleInterceptNetworkUpdate(StringHash eventType, VariantMap& eventData)
+{
+	using namespace InterceptNetworkUpdate;
+
+	const String& name = eventData[P_NAME].GetString();
+	const Variant& value = eventData[P_VALUE];
+	// Each attribute arrives as its own event, rotation and velocity after position, so the
+	// state is only pushed on the next Update; attributes not sent keep their last values
+	if (name == "Network Position")
+		pendingPosition = value.GetVector3();
+	else if (name == "Network Rotation")
+		pendingRotation = MemoryBuffer(value.GetBuffer()).ReadPackedQuaternion();
+	else if (name == "Linear Velocity")
+		pendingVelocity = value.GetVector3();
+	else
+		return;
+	received = true;
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <Urho3D/Scene/LogicComponent.h>
+
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+// Recent network states of one object, for drawing it slightly in the past
+// (interpolation) or, when updates are late, ahead of the newest one (extrapolation).
+class ReckoningBuffer
+{
+public:
+	ReckoningBuffer() {};
+
+	// Add a state that arrived at the given local time
+	void Push(float time, const Vector3& position, const Quaternion& rotation, const Vector3& velocity);
+	// The state at the given local time. False if nothing has arrived yet.
+	bool Sample(float time, float maxExtrapolation, Vector3& position, Quaternion& rotation) const;
+	// Forget all states
+	void Clear() { count = 0; }
+
+private:
+	static const unsigned SIZE = 4;
+
+	float times[SIZE];
+	Vector3 positions[SIZE];
+	Quaternion rotations[SIZE];
+	Vector3 velocities[SIZE];
+	// Slot of the newest state, and how many are valid
+	unsigned newest = 0;
+	unsigned count = 0;
+};
+
+// Client side smoothing for a replicated moving node such as a player ball. Takes over the
+// node's network position, rotation and its rigid body's linear velocity, buffers them, and
+// places the node interpolationDelay in the past, extrapolating with the velocity when the
+// next update is late. This lets the server send these nodes at a low rate. Does nothing on the server.
+class DeadReckoning : public LogicComponent
+{
+	URHO3D_OBJECT(DeadReckoning, LogicComponent);
+
+public:
+	DeadReckoning(Context* context);
+
+	// Register object factory and attributes
+	static void RegisterObject(Context* context);
+
+	// Called by LogicComponent
+	virtual void Start();
+	virtual void Update(float timeStep);
+
+	// How far behind the newest update the node is drawn. One send interval hides a late packet.
+	float interpolationDelay = 0.1f;
+	// Longest time to extrapolate past the newest update before holding still
+	float maxExtrapolation = 0.25f;
+
+private:
+	void HandleInterceptNetworkUpdate(StringHash eventType, VariantMap& eventData);
+
+	ReckoningBuffer buffer;
+	// Attributes of the update being received; they arrive as separate events
+	Vector3 pendingPosition;
+	Quaternion pendingRotation;
+	Vector3 pendingVelocity;
+	// Local clock
+	float time = 0.0f;
+	// On a client and smoothing
+	bool active = false;
+	// Attributes arrived since the last Update
+	bool received = false;
+};
@@ -0,0 +1,182 @@
+#include "DeterministicFlock.h"
+
+void DeterministicFlock::Reset(unsigned seed)
+{
+	// Numerical Recipes LCG
+	unsigned rng = seed;
+	for (int i = 0; i < NumBoids; i++)
+	{
+		rng = rng * 1664525u + 1013904223u;
+		float x = (rng >> 8) / 16777216.0f * 40.0f - 20.0f;
+		rng = rng * 1664525u + 1013904223u;
+		float z = (rng >> 8) / 16777216.0f * 40.0f - 20.0f;
+		positions[i] = Vector3(x, 10.0f, z);
+		velocities[i] = Vector3::ZERO;
+	}
+
+	historyPositions.Resize(FlockStateHistory * NumBoids);
+	historyVelocities.Resize(FlockStateHistory * NumBoids);
+	for (unsigned i = 0; i < FlockStateHistory; i++)
+		historyTicks[i] = M_MAX_UNSIGNED;
+	tick = 0;
+	Record();
+}
+
+void DeterministicFlock::Step(float timeStep)
+{
+	// All forces from the old state first, then integrate, so the result doesn't depend on update order
+	for (int i = 0; i < NumBoids; i++)
+	{
+		const Vector3 p = positions[i];
+		const Vector3 v = velocities[i];
+		Vector3 force;
+		Vector3 CoM;
+		Vector3 heading;
+		int n = 0;
+		for (int j = 0; j < NumBoids; j++)
+		{
+			if (j == i) continue;
+			Vector3 sep = p - positions[j];
+			float d = sep.Length();
+			if (d < Boid::Range_FAttract)
+			{
+				CoM += positions[j];
+				heading += velocities[j];
+				n++;
+			}
+			if (d < Boid::Range_FRepel && d > 0)
+				force += sep / d * Boid::FRepel_Factor;
+		}
+		if (n > 0)
+		{
+			//Attraction to the centre of mass
+			Vector3 dir = (CoM / (float)n - p).Normalized();
+			force += (dir * Boid::FAttract_Vmax - v) * Boid::FAttract_Factor;
+			//Alignment with the neighbours' heading
+			force += (heading / (float)n).Normalized() - v;
+		}
+		if (Boid::pObstacles)
+		{
+			Vector3 gradient;
+			float d = Boid::pObstacles->Sample(p, gradient);
+			if (d < Boid::Range_FAvoid)
+				force += gradient.Normalized() * (Boid::Range_FAvoid - d) * Boid::FAvoid_Factor;
+		}
+		forces[i] = force;
+	}
+
+	// Unit mass, same speed and height limits as Boid::Update
+	for (int i = 0; i < NumBoids; i++)
+	{
+		Vector3 v = velocities[i] + forces[i] * timeStep;
+		float speed = v.Length();
+		if (speed < 10.0f)
+			v = (speed > 0.0f ? v / speed : Vector3::FORWARD) * 10.0f;
+		else if (speed > 50.0f)
+			v = v / speed * 50.0f;
+		Vector3 p = positions[i] + v * timeStep;
+		p.y_ = Clamp(p.y_, 10.0f, 50.0f);
+		positions[i] = p;
+		velocities[i] = v;
+	}
+
+	tick++;
+	Record();
+}
+
+void DeterministicFlock::SetTick(unsigned newTick)
+{
+	tick = newTick;
+	if (historyPositions.Empty())
+	{
+		historyPositions.Resize(FlockStateHistory * NumBoids);
+		historyVelocities.Resize(FlockStateHistory * NumBoids);
+	}
+	for (unsigned i = 0; i < FlockStateHistory; i++)
+		historyTicks[i] = M_MAX_UNSIGNED;
+	Record();
+}
+
+bool DeterministicFlock::Rewind(unsigned toTick)
+{
+	unsigned slot = toTick % FlockStateHistory;
+	if (historyPositions.Empty() || historyTicks[slot] != toTick)
+		return false;
+	for (int i = 0; i < NumBoids; i++)
+	{
+		positions[i] = historyPositions[slot * NumBoids + i];
+		velocities[i] = historyVelocities[slot * NumBoids + i];
+	}
+	tick = toTick;
+	return true;
+}
+
+unsigned DeterministicFlock::BlockChecksum(unsigned block) const
+{
+	return Checksum(positions, velocities, block);
+}
+
+bool DeterministicFlock::BlockChecksum(unsigned atTick, unsigned block, unsigned& checksum) const
+{
+	unsigned slot = atTick % FlockStateHistory;
+	if (historyPositions.Empty() || historyTicks[slot] != atTick)
+		return false;
+	checksum = Checksum(&historyPositions[slot * NumBoids], &historyVelocities[slot * NumBoids], block);
+	return true;
+}
+
+void DeterministicFlock::WriteState(Serializer& dest, unsigned first, unsigned count) const
+{
+	for (unsigned i = first; i < first + count && i < (unsigned)NumBoids; i++)
+	{
+		dest.WriteVector3(positions[i]);
+		dest.WriteVector3(velocities[i]);
+	}
+}
+
+void DeterministicFlock::ReadState(Deserializer& source, unsigned first, unsigned count)
+{
+	for (unsigned i = first; i < first + count && i < (unsigned)NumBoids; i++)
+	{
+		positions[i] = source.ReadVector3();
+		velocities[i] = source.ReadVector3();
+	}
+}
+
+Quaternion DeterministicFlock::Heading(const Vector3& velocity)
+{
+	Vector3 vn = velocity.Normalized();
+	Vector3 cp = -vn.CrossProduct(Vector3(0.0f, 1.0f, 0.0f));
+	return Quaternion(Acos(cp.DotProduct(vn)), cp);
+}
+
+void DeterministicFlock::Record()
+{
+	if (historyPositions.Empty())
+		return;
+	unsigned slot = tick % FlockStateHistory;
+	historyTicks[slot] = tick;
+	for (int i = 0; i < NumBoids; i++)
+	{
+		historyPositions[slot * NumBoids + i] = positions[i];
+		historyVelocities[slot * NumBoids + i] = velocities[i];
+	}
+}
+
+unsigned DeterministicFlock::Checksum(const Vector3* pPositions, const Vector3* pVelocities, unsigned block)
+{
+	// FNV-1a over the exact bits, any divergence at all shows up
+	unsigned hash = 2166136261u;
+	unsigned first = block * FlockBlockSize;
+	unsigned last = Min(first + FlockBlockSize, (unsigned)NumBoids);
+	for (unsigned i = first; i < last; i++)
+	{
+		const unsigned char* pBytes = reinterpret_cast<const unsigned char*>(&pPositions[i]);
+		for (unsigned b = 0; b < sizeof(Vector3); b++)
+			hash = (hash ^ pBytes[b]) * 16777619u;
+		pBytes = reinterpret_cast<const unsigned char*>(&pVelocities[i]);
+		for (unsigned b = 0; b < sizeof(Vector3); b++)
+			hash = (hash ^ pBytes[b]) * 16777619u;
+	}
+	return hash;
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <Urho3D/IO/Deserializer.h>
+#include <Urho3D/IO/Serializer.h>
+#include "boids.h"
+
+namespace Urho3D
+{
+	// Exact states kept for rewinding, in ticks
+	const unsigned FlockStateHistory = 128;
+	// Boids per checksum block
+	const unsigned FlockBlockSize = 32;
+	const unsigned NumFlockBlocks = (NumBoids + FlockBlockSize - 1) / FlockBlockSize;
+}
+using namespace Urho3D;
+
+// The flock as plain position/velocity arrays stepped at a fixed rate without Bullet,
+// so that the same initial state and parameters give bit-identical results on every
+// machine running the same build. Uses the Boid rules and parameters.
+// Every step's result is kept for FlockStateHistory ticks so a correction for a past
+// tick can be applied there and the flock re-simulated up to the present.
+class DeterministicFlock
+{
+public:
+	DeterministicFlock() {};
+
+	Vector3 positions[NumBoids];
+	Vector3 velocities[NumBoids];
+
+	// Seeded starting state; uses its own generator so other Random() users can't disturb it
+	void Reset(unsigned seed);
+	// Advance one tick
+	void Step(float timeStep);
+	unsigned GetTick() const { return tick; }
+	// Adopt a state received for the given tick
+	void SetTick(unsigned newTick);
+
+	// Restore the recorded state of a past tick. False if it is no longer in the history.
+	bool Rewind(unsigned toTick);
+	// Re-record the current tick after its state was edited in place
+	void Record();
+	// Checksum of one block of boids, now or at a past tick. False if the tick isn't recorded.
+	unsigned BlockChecksum(unsigned block) const;
+	bool BlockChecksum(unsigned atTick, unsigned block, unsigned& checksum) const;
+
+	// Exact (unquantised) state of a range of boids
+	void WriteState(Serializer& dest, unsigned first, unsigned count) const;
+	void ReadState(Deserializer& source, unsigned first, unsigned count);
+
+	// Boid rotation for display, from its velocity as in Boid::Update
+	static Quaternion Heading(const Vector3& velocity);
+
+private:
+	static unsigned Checksum(const Vector3* pPositions, const Vector3* pVelocities, unsigned block);
+
+	unsigned tick = 0;
+	Vector3 forces[NumBoids];
+	unsigned historyTicks[FlockStateHistory];
+	PODVector<Vector3> historyPositions;
+	PODVector<Vector3> historyVelocities;
+};
@@ -0,0 +1,547 @@
+#include <Urho3D/Container/Sort.h>
+#include "FlockReplication.h"
+#include "NetworkEmulator.h"
+
+static const float SMALLEST_THREE_RANGE = 0.70710678f;
+
+static unsigned ZigZag(int v)
+{
+	return ((unsigned)v << 1) ^ (unsigned)(v >> 31);
+}
+
+static int UnZigZag(unsigned v)
+{
+	return (int)(v >> 1) ^ -(int)(v & 1);
+}
+
+// Sequence of the state streamed to a joining client
+static const unsigned JOIN_SEQ = 1;
+
+struct JoinOrderEntry
+{
+	float distSq;
+	unsigned index;
+};
+
+static bool CompareJoinOrder(const JoinOrderEntry& lhs, const JoinOrderEntry& rhs)
+{
+	return lhs.distSq < rhs.distSq;
+}
+
+static short QuantiseSpeed(float v)
+{
+	return (short)RoundToInt(Clamp(v / FlockVelocityRange, -1.0f, 1.0f) * 32767.0f);
+}
+
+QuantisedBoid FlockCodec::Quantise(const Vector3& position, const Quaternion& rotation, const Vector3& velocity)
+{
+	QuantisedBoid q;
+	Vector3 n = (position - FlockBounds.min_) / FlockBounds.Size();
+	q.x = (unsigned short)RoundToInt(Clamp(n.x_, 0.0f, 1.0f) * 65535.0f);
+	q.y = (unsigned short)RoundToInt(Clamp(n.y_, 0.0f, 1.0f) * 65535.0f);
+	q.z = (unsigned short)RoundToInt(Clamp(n.z_, 0.0f, 1.0f) * 65535.0f);
+	q.vx = QuantiseSpeed(velocity.x_);
+	q.vy = QuantiseSpeed(velocity.y_);
+	q.vz = QuantiseSpeed(velocity.z_);
+
+	// Smallest three: drop the largest component (recoverable from unit length),
+	// flip the sign so it is positive, and store the other three in 10 bits each
+	float c[4] = { rotation.w_, rotation.x_, rotation.y_, rotation.z_ };
+	unsigned largest = 0;
+	for (unsigned i = 1; i < 4; i++)
+	{
+		if (Abs(c[i]) > Abs(c[largest]))
+			largest = i;
+	}
+	float sign = c[largest] < 0.0f ? -1.0f : 1.0f;
+	q.rotation = largest << 30;
+	unsigned shift = 20;
+	for (unsigned i = 0; i < 4; i++)
+	{
+		if (i == largest)
+			continue;
+		float v = (c[i] * sign / SMALLEST_THREE_RANGE + 1.0f) * 0.5f;
+		q.rotation |= (unsigned)RoundToInt(Clamp(v, 0.0f, 1.0f) * 1023.0f) << shift;
+		shift -= 10;
+	}
+	return q;
+}
+
+Vector3 FlockCodec::DequantisePosition(const QuantisedBoid& q)
+{
+	Vector3 n(q.x / 65535.0f, q.y / 65535.0f, q.z / 65535.0f);
+	return FlockBounds.min_ + n * FlockBounds.Size();
+}
+
+Vector3 FlockCodec::DequantiseVelocity(const QuantisedBoid& q)
+{
+	return Vector3((float)q.vx, (float)q.vy, (float)q.vz) * (FlockVelocityRange / 32767.0f);
+}
+
+Quaternion FlockCodec::DequantiseRotation(const QuantisedBoid& q)
+{
+	unsigned largest = q.rotation >> 30;
+	float c[4];
+	float sumSquares = 0.0f;
+	unsigned shift = 20;
+	for (unsigned i = 0; i < 4; i++)
+	{
+		if (i == largest)
+			continue;
+		float v = ((q.rotation >> shift) & 1023) / 1023.0f;
+		c[i] = (v * 2.0f - 1.0f) * SMALLEST_THREE_RANGE;
+		sumSquares += c[i] * c[i];
+		shift -= 10;
+	}
+	c[largest] = sqrtf(Max(1.0f - sumSquares, 0.0f));
+	return Quaternion(c[0], c[1], c[2], c[3]).Normalized();
+}
+
+void FlockCodec::WriteDelta(VectorBuffer& msg, const QuantisedBoid* pBaseline, const QuantisedBoid* pCurrent, unsigned numBoids)
+{
+	static const QuantisedBoid zero = { 0, 0, 0, 0, 0, 0, 0 };
+
+	// Three bits per boid: position changed, velocity changed, rotation changed
+	unsigned maskStart = msg.GetPosition();
+	unsigned maskBytes = (numBoids * 3 + 7) / 8;
+	for (unsigned i = 0; i < maskBytes; i++)
+		msg.WriteUByte(0);
+	// Writing can reallocate the buffer, so the mask pointer is re-fetched before each use
+	unsigned char* pMask;
+
+	for (unsigned i = 0; i < numBoids; i++)
+	{
+		const QuantisedBoid& base = pBaseline ? pBaseline[i] : zero;
+		const QuantisedBoid& cur = pCurrent[i];
+		if (cur.x != base.x || cur.y != base.y || cur.z != base.z)
+		{
+			pMask = msg.GetModifiableData() + maskStart;
+			pMask[(i * 3) >> 3] |= 1 << ((i * 3) & 7);
+			msg.WriteVLE(ZigZag((int)cur.x - (int)base.x));
+			msg.WriteVLE(ZigZag((int)cur.y - (int)base.y));
+			msg.WriteVLE(ZigZag((int)cur.z - (int)base.z));
+		}
+		if (cur.vx != base.vx || cur.vy != base.vy || cur.vz != base.vz)
+		{
+			pMask = msg.GetModifiableData() + maskStart;
+			pMask[(i * 3 + 1) >> 3] |= 1 << ((i * 3 + 1) & 7);
+			msg.WriteVLE(ZigZag((int)cur.vx - (int)base.vx));
+			msg.WriteVLE(ZigZag((int)cur.vy - (int)base.vy));
+			msg.WriteVLE(ZigZag((int)cur.vz - (int)base.vz));
+		}
+		if (cur.rotation != base.rotation)
+		{
+			pMask = msg.GetModifiableData() + maskStart;
+			pMask[(i * 3 + 2) >> 3] |= 1 << ((i * 3 + 2) & 7);
+			msg.WriteUInt(cur.rotation);
+		}
+	}
+}
+
+bool FlockCodec::ReadDelta(MemoryBuffer& msg, const QuantisedBoid* pBaseline, QuantisedBoid* pCurrent, unsigned numBoids)
+{
+	static const QuantisedBoid zero = { 0, 0, 0, 0, 0, 0, 0 };
+
+	unsigned maskBytes = (numBoids * 3 + 7) / 8;
+	if (msg.GetSize() - msg.GetPosition() < maskBytes)
+		return false;
+	PODVector<unsigned char> mask(maskBytes);
+	msg.Read(&mask[0], maskBytes);
+
+	for (unsigned i = 0; i < numBoids; i++)
+	{
+		pCurrent[i] = pBaseline ? pBaseline[i] : zero;
+		if (mask[(i * 3) >> 3] & (1 << ((i * 3) & 7)))
+		{
+			pCurrent[i].x = (unsigned short)((int)pCurrent[i].x + UnZigZag(msg.ReadVLE()));
+			pCurrent[i].y = (unsigned short)((int)pCurrent[i].y + UnZigZag(msg.ReadVLE()));
+			pCurrent[i].z = (unsigned short)((int)pCurrent[i].z + UnZigZag(msg.ReadVLE()));
+		}
+		if (mask[(i * 3 + 1) >> 3] & (1 << ((i * 3 + 1) & 7)))
+		{
+			pCurrent[i].vx = (short)((int)pCurrent[i].vx + UnZigZag(msg.ReadVLE()));
+			pCurrent[i].vy = (short)((int)pCurrent[i].vy + UnZigZag(msg.ReadVLE()));
+			pCurrent[i].vz = (short)((int)pCurrent[i].vz + UnZigZag(msg.ReadVLE()));
+		}
+		if (mask[(i * 3 + 2) >> 3] & (1 << ((i * 3 + 2) & 7)))
+			pCurrent[i].rotation = msg.ReadUInt();
+	}
+	return true;
+}
+
+void FlockHistoryRing::Reset(unsigned numBoids)
+{
+	this->numBoids = numBoids;
+	states.Resize(numBoids * FlockHistory);
+	for (unsigned i = 0; i < FlockHistory; i++)
+		seqs[i] = 0;
+}
+
+QuantisedBoid* FlockHistoryRing::Store(unsigned seq)
+{
+	unsigned slot = seq % FlockHistory;
+	seqs[slot] = seq;
+	return &states[slot * numBoids];
+}
+
+const QuantisedBoid* FlockHistoryRing::Find(unsigned seq) const
+{
+	unsigned slot = seq % FlockHistory;
+	if (!seq || !numBoids || seqs[slot] != seq)
+		return nullptr;
+	return &states[slot * numBoids];
+}
+
+void FlockServer::BeginJoin(Connection* pConnection)
+{
+	// A rejoining client's history may still be written to
+	Wait();
+	ClientState& client = clients[pConnection];
+	client.history.Reset(NumBoids);
+	client.nextSeq = JOIN_SEQ;
+	client.ackedSeq = 0;
+	client.joinOrder.Clear();
+	client.joinNext = 0;
+}
+
+void FlockServer::SendJoinChunk(Connection* pConnection, ClientState& client)
+{
+	static const QuantisedBoid unsent = { 0, 0, 0, 0, 0, 0, 0 };
+
+	QuantisedBoid* pJoin = client.history.Store(JOIN_SEQ);
+	// Order fixed on the first chunk, from wherever the client is looking then: the origin if it
+	// is still loading the scene and hasn't reported a position yet
+	if (client.joinOrder.Empty())
+	{
+		Vector3 eye = pConnection->GetPosition();
+		PODVector<JoinOrderEntry> order(NumBoids);
+		for (unsigned i = 0; i < NumBoids; i++)
+		{
+			order[i].distSq = (positions[i] - eye).LengthSquared();
+			order[i].index = i;
+		}
+		Sort(order.Begin(), order.End(), CompareJoinOrder);
+		client.joinOrder.Resize(NumBoids);
+		for (unsigned i = 0; i < NumBoids; i++)
+			client.joinOrder[i] = order[i].index;
+		for (unsigned i = 0; i < NumBoids; i++)
+			pJoin[i] = unsent;
+	}
+
+	// Each chunk carries the boids' state as of this tick. A few hundred bytes of quantised
+	// state doesn't compress, so it goes as it is.
+	unsigned end = Min(client.joinNext + Max(joinChunkSize, 1U), (unsigned)NumBoids);
+	bool last = end == NumBoids;
+	msg.Clear();
+	msg.WriteBool(last);
+	msg.WriteVLE(NumBoids);
+	msg.WriteVLE(end - client.joinNext);
+	for (unsigned i = client.joinNext; i < end; i++)
+	{
+		unsigned index = client.joinOrder[i];
+		const QuantisedBoid& q = current[index];
+		pJoin[index] = q;
+		msg.WriteVLE(index);
+		msg.WriteUShort(q.x);
+		msg.WriteUShort(q.y);
+		msg.WriteUShort(q.z);
+		msg.WriteShort(q.vx);
+		msg.WriteShort(q.vy);
+		msg.WriteShort(q.vz);
+		msg.WriteUInt(q.rotation);
+	}
+	client.joinNext = end;
+
+	// Reliable and in order: the chunks add up to the client's first baseline
+	NetworkEmulator::Send(pConnection, MSG_FLOCKJOIN, true, true, msg);
+
+	// The channel is reliable, so the whole join state counts as acknowledged
+	if (last)
+	{
+		client.ackedSeq = JOIN_SEQ;
+		client.nextSeq = JOIN_SEQ + 1;
+	}
+}
+
+void FlockServer::RemoveConnection(Connection* pConnection)
+{
+	// Its snapshot may still be being written into its history, and must not be sent
+	Wait();
+	for (unsigned j = 0; j < numJobs; j++)
+	{
+		if (jobs[j].pConnection == pConnection)
+			jobs[j].pConnection = nullptr;
+	}
+	clients.Erase(pConnection);
+}
+
+void FlockServer::Reset()
+{
+	Wait();
+	numJobs = 0;
+	clients.Clear();
+}
+
+void FlockServer::HandleAck(Connection* pConnection, MemoryBuffer& msg)
+{
+	HashMap<Connection*, ClientState>::Iterator i = clients.Find(pConnection);
+	if (i == clients.End())
+		return;
+	unsigned seq = msg.ReadVLE();
+	// Acks arrive unordered; only ever move forwards, and never past what was sent
+	if (seq > i->second_.ackedSeq && seq < i->second_.nextSeq)
+		i->second_.ackedSeq = seq;
+}
+
+void FlockServer::Send(const BoidSet& boids, const Vector<SharedPtr<Connection> >& connections)
+{
+	// The last send's snapshots read current and positions, which are about to change
+	Flush();
+
+	current.Resize(NumBoids);
+	positions.Resize(NumBoids);
+	for (unsigned i = 0; i < NumBoids; i++)
+	{
+		const Boid& boid = boids.boidList[i];
+		positions[i] = boid.pNode->GetWorldPosition();
+		current[i] = FlockCodec::Quantise(positions[i], boid.pNode->GetWorldRotation(), boid.pRigidBody->GetLinearVelocity());
+	}
+
+	// Join chunks go out every network tick
+	for (unsigned c = 0; c < connections.Size(); c++)
+	{
+		HashMap<Connection*, ClientState>::Iterator i = clients.Find(connections[c]);
+		if (i != clients.End() && i->second_.nextSeq == JOIN_SEQ)
+			SendJoinChunk(connections[c], i->second_);
+	}
+
+	if (sendTimer.GetMSec(false) < (unsigned)(sendInterval * 1000.0f))
+		return;
+	sendTimer.Reset();
+
+	for (unsigned c = 0; c < connections.Size(); c++)
+	{
+		Connection* pConnection = connections[c];
+		// Only clients whose join stream has finished
+		HashMap<Connection*, ClientState>::Iterator state = clients.Find(pConnection);
+		if (state == clients.End() || state->second_.nextSeq == JOIN_SEQ || !pConnection->IsSceneLoaded())
+			continue;
+
+		ClientState& client = state->second_;
+		if (numJobs == jobs.Size())
+			jobs.Resize(numJobs + 1);
+		SnapshotJob& job = jobs[numJobs++];
+		job.pConnection = pConnection;
+		job.seq = client.nextSeq++;
+		// Delta against the newest acknowledged snapshot, if the ring still holds it
+		job.pBaseline = nullptr;
+		if (client.ackedSeq && job.seq - client.ackedSeq < FlockHistory)
+			job.pBaseline = client.history.Find(client.ackedSeq);
+		job.baselineSeq = job.pBaseline ? client.ackedSeq : 0;
+		job.pView = client.history.Store(job.seq);
+		job.eye = pConnection->GetPosition();
+	}
+
+	if (!pWorkQueue)
+	{
+		for (unsigned j = 0; j < numJobs; j++)
+			WriteSnapshot(jobs[j]);
+		Flush();
+		return;
+	}
+	for (unsigned j = 0; j < numJobs; j++)
+	{
+		SharedPtr<WorkItem> item = pWorkQueue->GetFreeItem();
+		item->priority_ = FlockWorkPriority;
+		item->workFunction_ = SnapshotWork;
+		item->aux_ = this;
+		item->start_ = &jobs[j];
+		pWorkQueue->AddWorkItem(item);
+	}
+	working = numJobs > 0;
+}
+
+void FlockServer::Flush()
+{
+	Wait();
+	for (unsigned j = 0; j < numJobs; j++)
+	{
+		// Unreliable: a lost snapshot is superseded by the next one, and dead reckoning covers the gap
+		if (jobs[j].pConnection)
+			NetworkEmulator::Send(jobs[j].pConnection, MSG_FLOCKSNAPSHOT, false, false, jobs[j].msg);
+	}
+	numJobs = 0;
+}
+
+void FlockServer::Wait()
+{
+	if (!working)
+		return;
+	// The main thread takes jobs too while it waits
+	pWorkQueue->Complete(FlockWorkPriority);
+	working = false;
+}
+
+void FlockServer::SnapshotWork(const WorkItem* pItem, unsigned threadIndex)
+{
+	const FlockServer* pServer = static_cast<const FlockServer*>(pItem->aux_);
+	pServer->WriteSnapshot(*static_cast<SnapshotJob*>(pItem->start_));
+}
+
+void FlockServer::WriteSnapshot(SnapshotJob& job) const
+{
+	static const QuantisedBoid unsent = { 0, 0, 0, 0, 0, 0, 0 };
+
+	// Start from what the client already has, then bring the boids it is interested in up to date
+	float interestSq = interestRadius * interestRadius;
+	float cullSq = cullRadius > 0.0f ? cullRadius * cullRadius : M_INFINITY;
+	for (unsigned i = 0; i < NumBoids; i++)
+	{
+		job.pView[i] = job.pBaseline ? job.pBaseline[i] : unsent;
+		float distSq = (positions[i] - job.eye).LengthSquared();
+		if (distSq > cullSq)
+			continue;
+		// Far boids are staggered by index so each tick carries an even share of them
+		if (distSq > interestSq && (!farInterval || (job.seq + i) % farInterval))
+			continue;
+		job.pView[i] = current[i];
+	}
+
+	job.msg.Clear();
+	job.msg.WriteVLE(job.seq);
+	job.msg.WriteVLE(job.baselineSeq);
+	job.msg.WriteVLE(NumBoids);
+	FlockCodec::WriteDelta(job.msg, job.pBaseline, job.pView, NumBoids);
+}
+
+void FlockClient::Reset()
+{
+	static const QuantisedBoid unsent = { 0, 0, 0, 0, 0, 0, 0 };
+
+	history.Reset(NumBoids);
+	latestSeq = 0;
+	joining = false;
+	joined = false;
+	received.Resize(NumBoids);
+	buffers.Resize(NumBoids);
+	for (unsigned i = 0; i < NumBoids; i++)
+	{
+		received[i] = unsent;
+		buffers[i].Clear();
+	}
+}
+
+void FlockClient::HandleJoinChunk(MemoryBuffer& msg)
+{
+	static const QuantisedBoid unsent = { 0, 0, 0, 0, 0, 0, 0 };
+
+	bool last = msg.ReadBool();
+	unsigned numBoids = msg.ReadVLE();
+	if (numBoids != NumBoids)
+		return;
+
+	// First chunk of a join: start from an empty flock
+	if (!joining || joined)
+	{
+		Reset();
+		joining = true;
+		QuantisedBoid* pJoin = history.Store(JOIN_SEQ);
+		for (unsigned i = 0; i < NumBoids; i++)
+			pJoin[i] = unsent;
+	}
+	// Same slot every chunk; nothing else is stored until the join is over
+	QuantisedBoid* pJoin = history.Store(JOIN_SEQ);
+
+	unsigned count = msg.ReadVLE();
+	for (unsigned c = 0; c < count && !msg.IsEof(); c++)
+	{
+		unsigned index = msg.ReadVLE();
+		QuantisedBoid q;
+		q.x = msg.ReadUShort();
+		q.y = msg.ReadUShort();
+		q.z = msg.ReadUShort();
+		q.vx = msg.ReadShort();
+		q.vy = msg.ReadShort();
+		q.vz = msg.ReadShort();
+		q.rotation = msg.ReadUInt();
+		if (index >= NumBoids)
+			continue;
+		// Nearest boids arrive first and can be drawn straight away
+		pJoin[index] = q;
+		received[index] = q;
+		buffers[index].Push(time, FlockCodec::DequantisePosition(q), FlockCodec::DequantiseRotation(q),
+			FlockCodec::DequantiseVelocity(q));
+	}
+
+	if (last)
+	{
+		joined = true;
+		latestSeq = Max(latestSeq, JOIN_SEQ);
+	}
+}
+
+void FlockClient::HandleSnapshot(Connection* pServer, MemoryBuffer& msg)
+{
+	if (!joined)
+		return;
+
+	unsigned seq = msg.ReadVLE();
+	unsigned baseSeq = msg.ReadVLE();
+	unsigned numBoids = msg.ReadVLE();
+	// Stale or duplicate, or a flock of a different size
+	if (seq <= latestSeq || numBoids != NumBoids)
+		return;
+
+	const QuantisedBoid* pBaseline = nullptr;
+	if (baseSeq)
+	{
+		pBaseline = history.Find(baseSeq);
+		// Baseline already overwritten; a later snapshot will use a newer ack
+		if (!pBaseline)
+			return;
+	}
+
+	QuantisedBoid* pView = history.Store(seq);
+	if (!FlockCodec::ReadDelta(msg, pBaseline, pView, numBoids))
+	{
+		history.Reset(NumBoids);
+		return;
+	}
+	latestSeq = seq;
+
+	for (unsigned i = 0; i < numBoids; i++)
+	{
+		// Never sent; a real rotation never packs to zero
+		if (!pView[i].rotation)
+			continue;
+		// Carried over from the baseline: pushing it again would stall the boid
+		const QuantisedBoid& last = received[i];
+		if (pView[i].x == last.x && pView[i].y == last.y && pView[i].z == last.z && pView[i].rotation == last.rotation)
+			continue;
+		received[i] = pView[i];
+		buffers[i].Push(time, FlockCodec::DequantisePosition(pView[i]), FlockCodec::DequantiseRotation(pView[i]),
+			FlockCodec::DequantiseVelocity(pView[i]));
+	}
+
+	ack.Clear();
+	ack.WriteVLE(seq);
+	NetworkEmulator::Send(pServer, MSG_FLOCKACK, false, false, ack);
+}
+
+void FlockClient::Update(float timeStep, BoidSet& boids)
+{
+	time += timeStep;
+	if (buffers.Size() != NumBoids)
+		return;
+
+	Vector3 position;
+	Quaternion rotation;
+	for (unsigned i = 0; i < NumBoids; i++)
+	{
+		if (!buffers[i].Sample(time - interpolationDelay, maxExtrapolation, position, rotation))
+			continue;
+		Node* pNode = boids.boidList[i].pNode;
+		pNode->SetWorldPosition(position);
+		pNode->SetWorldRotation(rotation);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,185 @@
+#pragma once
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Core/WorkQueue.h>
+#include <Urho3D/IO/MemoryBuffer.h>
+#include <Urho3D/IO/VectorBuffer.h>
+#include <Urho3D/Math/BoundingBox.h>
+#include <Urho3D/Network/Connection.h>
+#include "boids.h"
+#include "DeadReckoning.h"
+#include "NetworkProtocol.h"
+
+namespace Urho3D
+{
+	// Boid positions are quantised to 16 bits per axis inside these bounds
+	const BoundingBox FlockBounds(Vector3(-512.0f, -8.0f, -512.0f), Vector3(512.0f, 120.0f, 512.0f));
+	// Boid velocities are quantised to 16 bits per axis within plus or minus this speed
+	const float FlockVelocityRange = 64.0f;
+	// Snapshots remembered per connection for delta baselines
+	const unsigned FlockHistory = 32;
+	// WorkQueue priority of threaded snapshot serialisation: below the items other code waits on
+	const unsigned FlockWorkPriority = 1;
+}
+using namespace Urho3D;
+
+// 16 bits per position and velocity axis and a smallest-three rotation in 32 bits.
+// A zero rotation means the boid has not been sent: no unit quaternion packs to 0.
+struct QuantisedBoid
+{
+	unsigned short x, y, z;
+	short vx, vy, vz;
+	unsigned rotation;
+};
+
+// Quantisation and delta coding shared by both ends of the flock channel
+class FlockCodec
+{
+public:
+	static QuantisedBoid Quantise(const Vector3& position, const Quaternion& rotation, const Vector3& velocity);
+	static Vector3 DequantisePosition(const QuantisedBoid& q);
+	static Vector3 DequantiseVelocity(const QuantisedBoid& q);
+	static Quaternion DequantiseRotation(const QuantisedBoid& q);
+
+	// Write the boids in current that differ from baseline
+	static void WriteDelta(VectorBuffer& msg, const QuantisedBoid* pBaseline, const QuantisedBoid* pCurrent, unsigned numBoids);
+	// Read a delta written by WriteDelta; current starts as a copy of baseline. False if malformed.
+	static bool ReadDelta(MemoryBuffer& msg, const QuantisedBoid* pBaseline, QuantisedBoid* pCurrent, unsigned numBoids);
+};
+
+// Snapshots remembered for one peer: what that client's flock looked like after each sequence
+class FlockHistoryRing
+{
+public:
+	void Reset(unsigned numBoids);
+	// Slot for seq, overwriting whatever older snapshot was there
+	QuantisedBoid* Store(unsigned seq);
+	// Snapshot for seq, or null if it has been overwritten or never existed
+	const QuantisedBoid* Find(unsigned seq) const;
+
+private:
+	unsigned numBoids = 0;
+	unsigned seqs[FlockHistory];
+	PODVector<QuantisedBoid> states;
+};
+
+// Server end: one compact message per network tick per client for the whole flock,
+// delta coded against the newest snapshot that client has acknowledged.
+// Replaces generic node replication for boids, whose nodes are LOCAL.
+// Snapshots go out every sendInterval seconds rather than every network tick;
+// clients fill the gaps by dead reckoning with the velocity carried per boid.
+// A client is streamed the whole flock from the moment it connects, alongside the
+// scene download, nearest boids first in chunks of joinChunkSize, one chunk per
+// network tick. That state becomes sequence 1, the first delta baseline, so the
+// join payload is never sent again.
+// Interest management: boids near the position a client reports with
+// Connection::SetPosition are in every snapshot, boids further out only every
+// farInterval snapshots, and boids beyond cullRadius not at all.
+// With a work queue set, each client's snapshot is built and serialised on a
+// worker thread from the flock as it was at the end of the tick, and sent by
+// Flush later in the next frame, so the main thread carries on meanwhile.
+class FlockServer
+{
+public:
+	FlockServer() {};
+
+	// Seconds between snapshots. 0 sends one every network tick.
+	float sendInterval = 0.1f;
+	// Boids per join chunk
+	unsigned joinChunkSize = 16;
+	// Full update rate inside this distance of the client
+	float interestRadius = 80.0f;
+	// Snapshots between updates for boids outside interestRadius. 0 never sends them.
+	unsigned farInterval = 3;
+	// Boids further than this are never sent. 0 sends the whole flock.
+	float cullRadius = 0.0f;
+	// Serialise snapshots on these worker threads. Null serialises them inline in Send.
+	WorkQueue* pWorkQueue = nullptr;
+
+	// Start streaming the flock to a client that has just connected. Snapshots follow once it is
+	// done and the client has loaded the scene.
+	void BeginJoin(Connection* pConnection);
+	void RemoveConnection(Connection* pConnection);
+	void HandleAck(Connection* pConnection, MemoryBuffer& msg);
+	// Quantise the flock, send the next join chunk to joining clients and,
+	// every sendInterval, a snapshot to the clients that have joined
+	void Send(const BoidSet& boids, const Vector<SharedPtr<Connection> >& connections);
+	// Send the snapshots serialised since the last Send, waiting for any still being written
+	void Flush();
+	// Drop every client and unsent snapshot, for when the server stops
+	void Reset();
+
+private:
+	struct ClientState
+	{
+		FlockHistoryRing history;
+		unsigned nextSeq = 1;
+		// 0 until the client acknowledges something, meaning "delta from nothing"
+		unsigned ackedSeq = 0;
+		// Boid indices nearest first, and how many of them have been streamed
+		PODVector<unsigned> joinOrder;
+		unsigned joinNext = 0;
+	};
+
+	// One client's snapshot for this send. Everything that touches the client table is worked
+	// out on the main thread, so writing it only reads the flock and fills pView and msg.
+	struct SnapshotJob
+	{
+		Connection* pConnection;
+		unsigned seq;
+		unsigned baselineSeq;
+		const QuantisedBoid* pBaseline;
+		QuantisedBoid* pView;
+		Vector3 eye;
+		VectorBuffer msg;
+	};
+
+	// Send the client its next join chunk; the last one makes the streamed state its baseline
+	void SendJoinChunk(Connection* pConnection, ClientState& client);
+	void WriteSnapshot(SnapshotJob& job) const;
+	static void SnapshotWork(const WorkItem* pItem, unsigned threadIndex);
+	// Wait for the worker threads to finish writing snapshots
+	void Wait();
+
+	HashMap<Connection*, ClientState> clients;
+	Vector<SnapshotJob> jobs;
+	unsigned numJobs = 0;
+	bool working = false;
+	Timer sendTimer;
+	PODVector<QuantisedBoid> current;
+	PODVector<Vector3> positions;
+	VectorBuffer msg;
+};
+
+// Client end: decodes and acknowledges snapshots, buffering each boid's states
+// so Update can draw the flock interpolationDelay in the past, extrapolating along
+// the sent velocity when a snapshot is late. Boids the server has never sent
+// (culled by interest management) stay where they are.
+class FlockClient
+{
+public:
+	FlockClient() {};
+
+	// Seconds behind the newest snapshot the flock is drawn; one send interval hides a lost snapshot
+	float interpolationDelay = 0.1f;
+	// Longest time to run a boid on past its newest state
+	float maxExtrapolation = 0.3f;
+
+	void Reset();
+	void HandleJoinChunk(MemoryBuffer& msg);
+	void HandleSnapshot(Connection* pServer, MemoryBuffer& msg);
+	// Place the boid nodes for this frame
+	void Update(float timeStep, BoidSet& boids);
+
+private:
+	FlockHistoryRing history;
+	unsigned latestSeq = 0;
+	// Snapshots are deltas from the streamed join state, so they wait until all of it is here
+	bool joining = false;
+	bool joined = false;
+	// Last state pushed per boid; boids outside the interest radius repeat theirs between updates
+	PODVector<QuantisedBoid> received;
+	Vector<ReckoningBuffer> buffers;
+	float time = 0.0f;
+	VectorBuffer ack;
+};
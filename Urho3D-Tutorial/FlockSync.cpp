@@ -0,0 +1,187 @@
+#include "FlockSync.h"
+#include "NetworkEmulator.h"
+
+void FlockSync::SendSetup(Connection* pConnection, const DeterministicFlock& flock)
+{
+	msg.Clear();
+	msg.WriteVLE(seed);
+	msg.WriteUInt(flock.GetTick());
+	msg.WriteFloat(timeStep);
+	// Count first, so a client can reject the setup before taking any of it
+	msg.WriteVLE(NumBoids);
+	Boid::WriteParameters(msg);
+	flock.WriteState(msg, 0, NumBoids);
+	NetworkEmulator::Send(pConnection, MSG_FLOCKSETUP, true, true, msg);
+}
+
+void FlockSync::SendKeyframe(const DeterministicFlock& flock, const Vector<SharedPtr<Connection> >& connections)
+{
+	if (flock.GetTick() % keyframeInterval)
+		return;
+
+	msg.Clear();
+	msg.WriteUInt(flock.GetTick());
+	msg.WriteVLE(NumFlockBlocks);
+	for (unsigned b = 0; b < NumFlockBlocks; b++)
+		msg.WriteUInt(flock.BlockChecksum(b));
+	for (unsigned i = 0; i < connections.Size(); i++)
+	{
+		if (connections[i]->IsSceneLoaded())
+			NetworkEmulator::Send(connections[i], MSG_FLOCKKEYFRAME, false, false, msg);
+	}
+}
+
+void FlockSync::HandleResync(Connection* pConnection, MemoryBuffer& request, const DeterministicFlock& flock)
+{
+	request.ReadUInt();
+	unsigned numBlocks = request.ReadVLE();
+
+	// Answer with the current state rather than the keyframe's; the client rewinds to whichever tick it gets
+	msg.Clear();
+	msg.WriteUInt(flock.GetTick());
+	msg.WriteVLE(numBlocks);
+	for (unsigned i = 0; i < numBlocks && !request.IsEof(); i++)
+	{
+		unsigned block = request.ReadVLE();
+		if (block >= NumFlockBlocks)
+			block = 0;
+		msg.WriteVLE(block);
+		flock.WriteState(msg, block * FlockBlockSize, FlockBlockSize);
+	}
+	NetworkEmulator::Send(pConnection, MSG_FLOCKCORRECTION, true, true, msg);
+}
+
+void FlockSync::Reset()
+{
+	active = false;
+	hasPending = false;
+	accumulated = 0.0f;
+}
+
+void FlockSync::HandleSetup(MemoryBuffer& setup, DeterministicFlock& flock)
+{
+	unsigned setupSeed = setup.ReadVLE();
+	unsigned tick = setup.ReadUInt();
+	float setupStep = setup.ReadFloat();
+	if (setupStep <= 0.0f || setup.ReadVLE() != NumBoids)
+		return;
+	seed = setupSeed;
+	timeStep = setupStep;
+	accumulated = 0.0f;
+	Boid::ReadParameters(setup);
+	flock.ReadState(setup, 0, NumBoids);
+	flock.SetTick(tick);
+	active = true;
+	hasPending = false;
+}
+
+void FlockSync::Advance(DeterministicFlock& flock, float elapsed)
+{
+	// Step whenever more than half a tick is owed, so equal rates give one step per call
+	// whatever the rounding, and other rates average out to the server's
+	accumulated += elapsed;
+	while (accumulated > timeStep * 0.5f)
+	{
+		flock.Step(timeStep);
+		accumulated -= timeStep;
+	}
+}
+
+void FlockSync::HandleKeyframe(Connection* pServer, MemoryBuffer& keyframe, const DeterministicFlock& flock)
+{
+	if (!active)
+		return;
+	unsigned tick = keyframe.ReadUInt();
+	if (keyframe.ReadVLE() != NumFlockBlocks)
+		return;
+	pendingTick = tick;
+	for (unsigned b = 0; b < NumFlockBlocks; b++)
+		pendingChecksums[b] = keyframe.ReadUInt();
+	hasPending = true;
+	CheckPending(pServer, flock);
+}
+
+void FlockSync::CheckPending(Connection* pServer, const DeterministicFlock& flock)
+{
+	// Wait until we have simulated the keyframe's tick ourselves
+	if (!hasPending || flock.GetTick() < pendingTick)
+		return;
+	hasPending = false;
+	Compare(pServer, flock);
+}
+
+void FlockSync::Compare(Connection* pServer, const DeterministicFlock& flock)
+{
+	PODVector<unsigned> diverged;
+	for (unsigned b = 0; b < NumFlockBlocks; b++)
+	{
+		unsigned checksum;
+		// Too old to check: treat as diverged so it gets refreshed
+		if (!flock.BlockChecksum(pendingTick, b, checksum) || checksum != pendingChecksums[b])
+			diverged.Push(b);
+	}
+	if (diverged.Empty())
+		return;
+
+	msg.Clear();
+	msg.WriteUInt(pendingTick);
+	msg.WriteVLE(diverged.Size());
+	for (unsigned i = 0; i < diverged.Size(); i++)
+		msg.WriteVLE(diverged[i]);
+	NetworkEmulator::Send(pServer, MSG_FLOCKRESYNC, true, true, msg);
+}
+
+void FlockSync::RequestFullResync(Connection* pServer, unsigned tick)
+{
+	msg.Clear();
+	msg.WriteUInt(tick);
+	msg.WriteVLE(NumFlockBlocks);
+	for (unsigned b = 0; b < NumFlockBlocks; b++)
+		msg.WriteVLE(b);
+	NetworkEmulator::Send(pServer, MSG_FLOCKRESYNC, true, true, msg);
+}
+
+void FlockSync::HandleCorrection(Connection* pServer, MemoryBuffer& correction, DeterministicFlock& flock)
+{
+	if (!active)
+		return;
+	unsigned tick = correction.ReadUInt();
+	unsigned numBlocks = correction.ReadVLE();
+	unsigned now = flock.GetTick();
+
+	// Get to the server's tick: catch up if we are behind, rewind if we are ahead
+	if (tick > now)
+	{
+		// Every block: take the server's state as it stands, there is nothing to catch up
+		if (numBlocks == NumFlockBlocks)
+			flock.SetTick(tick);
+		// Too far behind to catch up inside a message handler: replace the whole flock instead
+		else if (tick - now > FlockStateHistory)
+		{
+			RequestFullResync(pServer, now);
+			return;
+		}
+		else
+		{
+			while (flock.GetTick() < tick)
+				flock.Step(timeStep);
+		}
+	}
+	else if (!flock.Rewind(tick))
+	{
+		// Past our history, so this state is stale
+		RequestFullResync(pServer, now);
+		return;
+	}
+
+	for (unsigned i = 0; i < numBlocks && !correction.IsEof(); i++)
+	{
+		unsigned block = correction.ReadVLE();
+		flock.ReadState(correction, block * FlockBlockSize, FlockBlockSize);
+	}
+	flock.Record();
+
+	// Re-simulate back up to where we were
+	while (flock.GetTick() < now)
+		flock.Step(timeStep);
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <Urho3D/IO/MemoryBuffer.h>
+#include <Urho3D/IO/VectorBuffer.h>
+#include <Urho3D/Network/Connection.h>
+#include "DeterministicFlock.h"
+#include "NetworkProtocol.h"
+
+// Lockstep flock: instead of streaming boid states, the server hands each client
+// the seed, parameters and exact state once, and both sides run DeterministicFlock.
+// Every keyframeInterval ticks the server sends a checksum per block of boids;
+// a client whose block differs asks for it and gets the exact state back, which it
+// applies at the server's tick and re-simulates from. In steady state the flock
+// costs a few bytes per keyframe however large it is.
+class FlockSync
+{
+public:
+	FlockSync() {};
+
+	// Ticks between checksum keyframes
+	unsigned keyframeInterval = 30;
+	// Seed the server started its flock from
+	unsigned seed = 0;
+	// Length of one flock tick in seconds: the server's physics step, sent to clients in the setup
+	// so that a client running physics at another rate still steps the flock exactly as the server does
+	float timeStep = 0.0f;
+
+	// Server
+	void SendSetup(Connection* pConnection, const DeterministicFlock& flock);
+	// Call after every tick; sends checksums when a keyframe is due
+	void SendKeyframe(const DeterministicFlock& flock, const Vector<SharedPtr<Connection> >& connections);
+	void HandleResync(Connection* pConnection, MemoryBuffer& msg, const DeterministicFlock& flock);
+
+	// Client
+	void Reset();
+	// True once the server's setup has arrived and the local flock should be stepped
+	bool IsActive() const { return active; }
+	void HandleSetup(MemoryBuffer& msg, DeterministicFlock& flock);
+	// Step the flock in server ticks for elapsed seconds of local physics time
+	void Advance(DeterministicFlock& flock, float elapsed);
+	void HandleKeyframe(Connection* pServer, MemoryBuffer& msg, const DeterministicFlock& flock);
+	// Apply a corrected state at its tick and re-simulate. Asks for a full resync if the tick is
+	// further behind or ahead than our history.
+	void HandleCorrection(Connection* pServer, MemoryBuffer& msg, DeterministicFlock& flock);
+	// Call after every tick; checks a keyframe that arrived before the client reached its tick
+	void CheckPending(Connection* pServer, const DeterministicFlock& flock);
+
+private:
+	void Compare(Connection* pServer, const DeterministicFlock& flock);
+	// Ask for every block as of the server's present
+	void RequestFullResync(Connection* pServer, unsigned tick);
+
+	bool active = false;
+	// Local physics time not yet stepped, in seconds; may be negative by up to half a tick
+	float accumulated = 0.0f;
+	// Newest keyframe not yet compared
+	bool hasPending = false;
+	unsigned pendingTick = 0;
+	unsigned pendingChecksums[NumFlockBlocks];
+	VectorBuffer msg;
+};
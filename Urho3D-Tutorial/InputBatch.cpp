@@ -0,0 +1,125 @@
+#include "InputBatch.h"
+#include "NetworkEmulator.h"
+#include "NetworkProtocol.h"
+
+void InputBatcher::Reset()
+{
+	seq = 0;
+	sinceSend = 0;
+}
+
+unsigned InputBatcher::Push(const Controls& controls)
+{
+	InputFrame& frame = history[++seq % InputHistory];
+	frame.seq = seq;
+	frame.buttons = controls.buttons_;
+	frame.yaw = controls.yaw_;
+	return seq;
+}
+
+void InputBatcher::Send(Connection* pServer)
+{
+	if (!seq || ++sinceSend < sendInterval)
+		return;
+	sinceSend = 0;
+
+	// Newest first: [newest seq][count][buttons, yaw]...
+	unsigned count = Min(Min(sendInterval * (redundancy + 1), seq), Min(InputHistory, 255U));
+	msg.Clear();
+	msg.WriteUInt(seq);
+	msg.WriteUByte((unsigned char)count);
+	for (unsigned i = 0; i < count; i++)
+	{
+		const InputFrame& frame = history[(seq - i) % InputHistory];
+		msg.WriteVLE(frame.buttons);
+		msg.WriteFloat(frame.yaw);
+	}
+	NetworkEmulator::Send(pServer, MSG_PLAYERINPUT, false, false, msg);
+}
+
+void InputJitterBuffer::Reset()
+{
+	newestSeq = 0;
+	nextSeq = 0;
+	underruns = 0;
+	last.seq = 0;
+	last.buttons = 0;
+	last.yaw = 0.0f;
+	late.Clear();
+	for (unsigned i = 0; i < InputHistory; i++)
+	{
+		frames[i].seq = 0;
+		guessed[i] = false;
+	}
+}
+
+void InputJitterBuffer::Receive(MemoryBuffer& msg)
+{
+	unsigned seq = msg.ReadUInt();
+	unsigned count = msg.ReadUByte();
+	if (!seq)
+		return;
+	// First batch: start playing targetDepth behind it
+	bool first = !newestSeq;
+	newestSeq = Max(newestSeq, seq);
+	if (first)
+		SkipToTarget();
+	// Stalled for longer than we remember: the gap is gone for good
+	if (GetDepth() >= InputHistory)
+		SkipToTarget();
+
+	for (unsigned i = 0; i < count && i < seq; i++)
+	{
+		InputFrame frame;
+		frame.seq = seq - i;
+		frame.buttons = msg.ReadVLE();
+		frame.yaw = msg.ReadFloat();
+		unsigned slot = frame.seq % InputHistory;
+		// Already played: if that was a guess and a wrong one, the step needs simulating again
+		if (frame.seq < nextSeq)
+		{
+			if (guessed[slot] && frames[slot].seq == frame.seq)
+			{
+				guessed[slot] = false;
+				if (frame.buttons != frames[slot].buttons || frame.yaw != frames[slot].yaw)
+				{
+					frames[slot] = frame;
+					LateInput input = { playedTick[slot], 0, frame.buttons, frame.yaw };
+					late.Push(input);
+				}
+			}
+			continue;
+		}
+		// Too old to keep
+		if (frame.seq + InputHistory <= newestSeq)
+			continue;
+		frames[slot] = frame;
+		guessed[slot] = false;
+	}
+}
+
+void InputJitterBuffer::Next(Controls& controls, unsigned& seq, unsigned tick)
+{
+	// A burst after a stall: drop back to the target instead of running late for good
+	if (GetDepth() > targetDepth + InputSlack)
+		SkipToTarget();
+
+	if (nextSeq && nextSeq <= newestSeq)
+	{
+		unsigned slot = nextSeq % InputHistory;
+		// Lost in every packet that carried it: hold the previous input for its step
+		guessed[slot] = frames[slot].seq != nextSeq;
+		if (!guessed[slot])
+			last = frames[slot];
+		last.seq = nextSeq++;
+		// Keep what was played, to tell whether a late arrival changes anything
+		frames[slot] = last;
+		playedTick[slot] = tick;
+	}
+	else
+		underruns++;
+
+	controls.buttons_ = last.buttons;
+	controls.yaw_ = last.yaw;
+	seq = last.seq;
+}
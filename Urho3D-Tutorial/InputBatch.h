@@ -0,0 +1,100 @@
+#pragma once
+#include <Urho3D/Input/Controls.h>
+#include <Urho3D/IO/MemoryBuffer.h>
+#include <Urho3D/IO/VectorBuffer.h>
+#include <Urho3D/Network/Connection.h>
+
+namespace Urho3D
+{
+	// Physics steps of input remembered at each end of the input channel
+	const unsigned InputHistory = 64;
+	// Input buffered on the server beyond its target depth before the oldest is dropped
+	const unsigned InputSlack = 4;
+}
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+// One physics step of a player's input. The game only steers by buttons and yaw.
+struct InputFrame
+{
+	unsigned seq;
+	unsigned buttons;
+	float yaw;
+};
+
+// An input that reached the server after its step was played with a guess, for rollback
+struct LateInput
+{
+	// Physics tick it was played at (Rollback::GetTick), and the ball it was for
+	unsigned tick;
+	unsigned nodeID;
+	unsigned buttons;
+	float yaw;
+};
+
+// Client end of the input channel (MSG_PLAYERINPUT). Every physics step's
+// controls are numbered and kept; every sendInterval steps one unreliable
+// packet carries the newest inputs, including ones already sent, so that an
+// input only goes missing if redundancy + 1 packets in a row are lost.
+class InputBatcher
+{
+public:
+	InputBatcher() {};
+
+	// Physics steps per packet, from -inputsend N
+	unsigned sendInterval = 1;
+	// Extra packets each input is repeated in, from -inputredundancy K
+	unsigned redundancy = 3;
+
+	void Reset();
+	// Number and remember this step's controls. Returns the input's sequence number.
+	unsigned Push(const Controls& controls);
+	// Send the batch to the server if this step is due
+	void Send(Connection* pServer);
+
+private:
+	InputFrame history[InputHistory];
+	unsigned seq = 0;
+	unsigned sinceSend = 0;
+	VectorBuffer msg;
+};
+
+// Server end of one player's input channel. Inputs are played out in order,
+// exactly one per physics tick, targetDepth ticks behind the newest received,
+// which absorbs uneven arrival and batched sends. When the next input hasn't
+// arrived the previous one is repeated and play-out waits, adding a tick of
+// depth; when too much has piled up the oldest are dropped back to the target.
+// A step played with a held input is remembered as a guess; if the real input
+// turns up afterwards and differs, it is queued in late for a rollback.
+class InputJitterBuffer
+{
+public:
+	InputJitterBuffer() {};
+
+	// Ticks of input held back, from -inputdelay N
+	unsigned targetDepth = 2;
+	// Ticks that had no new input to play
+	unsigned underruns = 0;
+	// Real inputs for steps already played with a guess; nodeID is left for the caller
+	PODVector<LateInput> late;
+
+	void Reset();
+	// Has the client sent any batches, i.e. does it use the input channel at all
+	bool IsActive() const { return newestSeq != 0; }
+	void Receive(MemoryBuffer& msg);
+	// The input for physics tick, and its sequence number
+	void Next(Controls& controls, unsigned& seq, unsigned tick);
+	unsigned GetDepth() const { return newestSeq >= nextSeq ? newestSeq - nextSeq + 1 : 0; }
+
+private:
+	// Play from targetDepth behind the newest received, without going below the first input
+	void SkipToTarget() { nextSeq = newestSeq > targetDepth ? newestSeq - targetDepth + 1 : 1; }
+
+	// Inputs waiting to be played, then the inputs that were played
+	InputFrame frames[InputHistory];
+	unsigned playedTick[InputHistory];
+	bool guessed[InputHistory];
+	InputFrame last;
+	unsigned newestSeq = 0;
+	unsigned nextSeq = 0;
+};
@@ -1,8 +1,11 @@
 #include "Missile.h"
+#include "CollisionLayers.h"
+#include "CollisionProxy.h"
 
 void Missile::Initialise(ResourceCache* pRes, Scene* pScene)
 {
-	pNode = pScene->CreateChild("Missile");
+	// Local like the boids: the pool holds raw pointers, which a client's scene load would otherwise clear
+	pNode = pScene->CreateChild("Missile", LOCAL);
 	pNode->SetPosition(Vector3(0.0f, 0.0f, 0.0f));
 	pNode->SetRotation(Quaternion(0.0f, 0.0f, 0.0f));
 	pNode->SetScale(1.0f);
@@ -11,23 +14,35 @@ void Missile::Initialise(ResourceCache* pRes, Scene* pScene)
 	pObject->SetMaterial(pRes->GetResource<Material>("Materials/Stone.xml"));
 	pObject->SetCastShadows(true);
 	pRigidBody = pNode->CreateComponent<RigidBody>();
-	pRigidBody->SetCollisionLayer(2);
+	CollisionMatrix::Apply(pRigidBody, COLGROUP_PROJECTILES);
 	pRigidBody->SetMass(1.0f);
 	pRigidBody->SetUseGravity(false);
 	pRigidBody->SetPosition(Vector3(0.0f, 0.0f, 0.0f));
-	pObject->SetEnabled(false);
-	isActive = false;
+	pCollisionShape = pNode->CreateComponent<CollisionShape>();
+	// Dynamic body, so a fitted primitive rather than the cone's triangle mesh
+	CollisionProxy::Apply(pCollisionShape, pObject->GetModel(), true);
+	Deactivate();
 }
 
 void Missile::Activate(float timeStep, Node* cameraNode)
 {
 	timer = currentTime + delay;
 	isActive = true;
+	targetID = 0;
 	pObject->SetEnabled(true);
+	pRigidBody->SetEnabled(true);
 	pRigidBody->SetPosition(cameraNode->GetPosition());
 	pRigidBody->SetLinearVelocity(cameraNode->GetDirection().Normalized() * 20.0f);
 }
 
+void Missile::Deactivate()
+{
+	// Out of the world as well as out of sight, so a spent missile doesn't block anything
+	pObject->SetEnabled(false);
+	pRigidBody->SetEnabled(false);
+	isActive = false;
+}
+
 bool Missile::CheckActive(bool returnActive)
 {
 	if (isActive == true)
@@ -44,22 +59,33 @@ bool Missile::CheckActive(bool returnActive)
 void Missile::Update(float timeStep)
 {
 	currentTime = currentTime + timeStep;
-	if (currentTime > timer)
-	{
-		pObject->SetEnabled(false);
-		isActive = false;
-	}
+	if (isActive && currentTime > timer)
+		Deactivate();
 	if (isActive == true)
 	{
-		pRigidBody->ApplyForce(Vector3(1, 0, 0));
+		pRigidBody->ApplyForce(force);
 	}
 }
 
-void MissileSet::Initialise(ResourceCache* pRes, Scene* pScene)
+void MissileSet::Initialise(ResourceCache* pRes, Scene* pScene, ContactReport& contacts)
 {
 	for (int i = 0; i < MaxMissiles; i++)
 	{
 		MissileList[i].Initialise(pRes, pScene);
+		contacts.SetReported(MissileList[i].pRigidBody, true);
+	}
+}
+
+void MissileSet::HandleContacts(const PODVector<ContactPair>& pairs)
+{
+	for (unsigned p = 0; p < pairs.Size(); p++)
+	{
+		for (int i = 0; i < MaxMissiles; i++)
+		{
+			Missile& m = MissileList[i];
+			if (m.isActive && (pairs[p].pBodyA == m.pRigidBody || pairs[p].pBodyB == m.pRigidBody))
+				m.Deactivate();
+		}
 	}
 }
 
@@ -78,10 +104,82 @@ void MissileSet::ActivateMissile(float timestep, Node* cameraNode)
 	}
 }
 
-void MissileSet::Update(float tm)
+void MissileSet::Update(float tm, const Vector3* pTargets, const unsigned* pTargetIDs, unsigned numTargets)
 {
+	// Bin the targets once for the whole pool, and find them again by node
+	targetGrid.Build(pTargets, numTargets, HomingRange);
+	targetIndex.Clear();
+	for (unsigned i = 0; i < numTargets; i++)
+		targetIndex[pTargetIDs[i]] = i;
+	AcquireTargets(pTargets, pTargetIDs);
+	Steer(pTargets);
 	for (int i = 0; i < MaxMissiles; i++)
 	{
 		MissileList[i].Update(tm);
 	}
+}
+
+void MissileSet::AcquireTargets(const Vector3* pTargets, const unsigned* pTargetIDs)
+{
+	for (int i = 0; i < MaxMissiles; i++)
+	{
+		Missile& m = MissileList[i];
+		aimIndex[i] = -1;
+		if (!m.isActive)
+		{
+			m.targetID = 0;
+			continue;
+		}
+		Vector3 p = m.pRigidBody->GetPosition();
+		// Keep the current target while it still exists and is in range, the grid lookup is only for re-acquiring
+		HashMap<unsigned, unsigned>::ConstIterator current = m.targetID ? targetIndex.Find(m.targetID) : targetIndex.End();
+		if (current != targetIndex.End() && (pTargets[current->second_] - p).LengthSquared() < HomingRange * HomingRange)
+		{
+			aimIndex[i] = current->second_;
+			continue;
+		}
+		aimIndex[i] = targetGrid.FindNearest(p, HomingRange);
+		m.targetID = aimIndex[i] >= 0 ? pTargetIDs[aimIndex[i]] : 0;
+	}
+}
+
+void MissileSet::Steer(const Vector3* pTargets)
+{
+	// Gather
+	for (int i = 0; i < MaxMissiles; i++)
+	{
+		const Missile& m = MissileList[i];
+		Vector3 p = m.pRigidBody->GetPosition();
+		Vector3 v = m.pRigidBody->GetLinearVelocity();
+		// Missiles without a target aim straight ahead along their velocity
+		Vector3 a = aimIndex[i] >= 0 ? pTargets[aimIndex[i]] : p + v;
+		posX[i] = p.x_; posY[i] = p.y_; posZ[i] = p.z_;
+		velX[i] = v.x_; velY[i] = v.y_; velZ[i] = v.z_;
+		aimX[i] = a.x_; aimY[i] = a.y_; aimZ[i] = a.z_;
+		hasAim[i] = (m.isActive && aimIndex[i] >= 0) ? 1.0f : 0.0f;
+	}
+
+	// Seek: force = (desired velocity - velocity) * gain, clamped. Branch free so it vectorises.
+	for (int i = 0; i < MaxMissiles; i++)
+	{
+		float dx = aimX[i] - posX[i];
+		float dy = aimY[i] - posY[i];
+		float dz = aimZ[i] - posZ[i];
+		float len = sqrtf(dx * dx + dy * dy + dz * dz) + M_EPSILON;
+		float s = HomingSpeed / len;
+		float sx = (dx * s - velX[i]) * HomingGain;
+		float sy = (dy * s - velY[i]) * HomingGain;
+		float sz = (dz * s - velZ[i]) * HomingGain;
+		float mag = sqrtf(sx * sx + sy * sy + sz * sz) + M_EPSILON;
+		float clamp = (mag > HomingMaxForce ? HomingMaxForce / mag : 1.0f) * hasAim[i];
+		fX[i] = sx * clamp;
+		fY[i] = sy * clamp;
+		fZ[i] = sz * clamp;
+	}
+
+	// Scatter
+	for (int i = 0; i < MaxMissiles; i++)
+	{
+		MissileList[i].force = Vector3(fX[i], fY[i], fZ[i]);
+	}
 }
\ No newline at end of file
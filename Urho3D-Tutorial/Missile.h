@@ -1,4 +1,5 @@
 #pragma once
+#include <Urho3D/Container/HashMap.h>
 #include <Urho3D/Engine/Application.h>
 #include <Urho3D/Input/Input.h>
 #include <Urho3D/Core/ProcessUtils.h>
@@ -19,6 +20,8 @@
 #include <Urho3D/Physics/RigidBody.h>
 #include <Urho3D/Resource/ResourceCache.h>
 #include <Urho3D/Scene/Scene.h>
+#include "ContactReport.h"
+#include "SpatialGrid.h"
 namespace Urho3D
 {
 	class Node;
@@ -26,8 +29,13 @@ namespace Urho3D
 	class RigidBody;
 	class CollisionShape;
 	class ResourceCache;
-	const int MaxMissiles = 3;
-	
+	// Pool size: missiles live for a few seconds, so this bounds how many can be in the air
+	const int MaxMissiles = 64;
+	// Homing: search radius for targets, cruise speed and steering response
+	const float HomingRange = 60.0f;
+	const float HomingSpeed = 30.0f;
+	const float HomingGain = 4.0f;
+	const float HomingMaxForce = 40.0f;
 
 }
 using namespace Urho3D;
@@ -47,12 +55,19 @@ public:
 	float timer = 0.0f;
 	float currentTime = 0.0f;
 	bool isActive = false;
+	// Node ID of the target, 0 when flying blind. Target arrays are rebuilt every update and
+	// their order changes when players leave, so an index into them would not stay on the same target.
+	unsigned targetID = 0;
+	// Steering force computed by MissileSet for this tick
+	Vector3 force;
 	// Destructor
 	~Missile() {};
 
 	void Initialise(ResourceCache* pRes, Scene* pScene);
 
 	void Activate(float timeStep, Node* cameraNode);
+	// Hide the missile and take its body out of the world
+	void Deactivate();
 
 	void Update(float timeStep);
 
@@ -66,7 +81,26 @@ class MissileSet
 	Missile MissileList[MaxMissiles];
 
 	MissileSet() {};
-	void Initialise(ResourceCache* pRes, Scene* pScene);
+	void Initialise(ResourceCache* pRes, Scene* pScene, ContactReport& contacts);
 	void ActivateMissile(float timeStep, Node* cameraNode);
-	void Update(float tm);
+	// A flying missile is spent once it touches anything
+	void HandleContacts(const PODVector<ContactPair>& pairs);
+	// Targets are boid and player positions, and their node IDs, gathered by the caller for this tick
+	void Update(float tm, const Vector3* pTargets, const unsigned* pTargetIDs, unsigned numTargets);
+
+private:
+	// One grid query per active missile instead of a scan of every target
+	void AcquireTargets(const Vector3* pTargets, const unsigned* pTargetIDs);
+	// Steering over the whole pool as flat arrays so the loop vectorises
+	void Steer(const Vector3* pTargets);
+
+	SpatialGrid targetGrid;
+	// This tick's index of each target node, and of each missile's target (-1 for none)
+	HashMap<unsigned, unsigned> targetIndex;
+	int aimIndex[MaxMissiles];
+	float posX[MaxMissiles], posY[MaxMissiles], posZ[MaxMissiles];
+	float velX[MaxMissiles], velY[MaxMissiles], velZ[MaxMissiles];
+	float aimX[MaxMissiles], aimY[MaxMissiles], aimZ[MaxMissiles];
+	float hasAim[MaxMissiles];
+	float fX[MaxMissiles], fY[MaxMissiles], fZ[MaxMissiles];
 };
\ No newline at end of file
@@ -0,0 +1,152 @@
+#include <Urho3D/Core/CoreEvents.h>
+#include <Urho3D/Container/Sort.h>
+#include <Urho3D/Network/Network.h>
+#include "NetworkEmulator.h"
+
+// Largest burst a capped connection can save up, in seconds of bandwidth
+static const float MAX_BURST = 0.1f;
+
+static bool CompareReleaseTime(const Pair<unsigned, unsigned>& lhs, const Pair<unsigned, unsigned>& rhs)
+{
+	// Release time, then queue position, so equal times keep their send order
+	return lhs.first_ != rhs.first_ ? lhs.first_ < rhs.first_ : lhs.second_ < rhs.second_;
+}
+
+NetworkEmulator::NetworkEmulator(Context* context) : Object(context)
+{
+	SubscribeToEvent(E_BEGINFRAME, URHO3D_HANDLER(NetworkEmulator, HandleBeginFrame));
+}
+
+void NetworkEmulator::SetConditions(int latencyMs, int jitterMs, float lossRate, unsigned bandwidth)
+{
+	this->jitterMs = Max(jitterMs, 0);
+	this->bandwidth = bandwidth;
+
+	// The transport delays and drops every packet, the game's messages included, so Queue
+	// must not add either again
+	Network* pNetwork = GetSubsystem<Network>();
+	pNetwork->SetSimulatedLatency(Max(latencyMs, 0));
+	pNetwork->SetSimulatedPacketLoss(Clamp(lossRate, 0.0f, 1.0f));
+}
+
+void NetworkEmulator::Send(Connection* pConnection, int msgID, bool reliable, bool inOrder, const VectorBuffer& msg)
+{
+	NetworkEmulator* pEmulator = pConnection->GetSubsystem<NetworkEmulator>();
+	if (pEmulator && pEmulator->IsEnabled())
+		pEmulator->Queue(pConnection, msgID, reliable, inOrder, msg);
+	else
+		pConnection->SendMessage(msgID, reliable, inOrder, msg);
+}
+
+void NetworkEmulator::Queue(Connection* pConnection, int msgID, bool reliable, bool inOrder, const VectorBuffer& msg)
+{
+	// Only the jitter; the latency and loss are applied by the transport once sent
+	unsigned delay = (unsigned)(Random() * jitterMs);
+
+	Pending pending;
+	pending.connection = pConnection;
+	pending.msgID = msgID;
+	pending.reliable = reliable;
+	pending.inOrder = inOrder;
+	pending.data = msg.GetBuffer();
+	pending.releaseTime = clock.GetMSec(false) + delay;
+	if (inOrder)
+	{
+		Link& link = GetLink(pConnection);
+		pending.releaseTime = Max(pending.releaseTime, link.lastInOrderRelease);
+		link.lastInOrderRelease = pending.releaseTime;
+	}
+	queue.Push(pending);
+}
+
+void NetworkEmulator::HandleBeginFrame(StringHash eventType, VariantMap& eventData)
+{
+	unsigned now = clock.GetMSec(false);
+	float elapsed = (now - lastFrameTime) / 1000.0f;
+	lastFrameTime = now;
+
+	// Refill the bandwidth budgets
+	for (HashMap<Connection*, Link>::Iterator i = links.Begin(); i != links.End(); ++i)
+		i->second_.budget = Min(i->second_.budget + bandwidth * elapsed, bandwidth * MAX_BURST);
+
+	if (queue.Empty())
+		return;
+
+	// Due messages in release order
+	PODVector<Pair<unsigned, unsigned> > due;
+	for (unsigned i = 0; i < queue.Size(); i++)
+	{
+		if (queue[i].releaseTime <= now)
+			due.Push(MakePair(queue[i].releaseTime, i));
+	}
+	Sort(due.Begin(), due.End(), CompareReleaseTime);
+
+	PODVector<bool> sent(queue.Size());
+	for (unsigned i = 0; i < sent.Size(); i++)
+		sent[i] = false;
+	// A connection out of budget holds everything behind it too, as a real link would
+	PODVector<Connection*> blocked;
+	for (unsigned i = 0; i < due.Size(); i++)
+	{
+		unsigned index = due[i].second_;
+		Pending& pending = queue[index];
+		Connection* pConnection = pending.connection;
+		if (!pConnection)
+		{
+			sent[index] = true;
+			continue;
+		}
+		if (blocked.Contains(pConnection))
+			continue;
+		if (bandwidth)
+		{
+			Link& link = GetLink(pConnection);
+			// A message bigger than the burst goes once the budget is full, and leaves it in debt
+			if (link.budget < Min((float)pending.data.Size(), bandwidth * MAX_BURST))
+			{
+				blocked.Push(pConnection);
+				continue;
+			}
+			link.budget -= pending.data.Size();
+		}
+		pConnection->SendMessage(pending.msgID, pending.reliable, pending.inOrder, pending.data.Buffer(), pending.data.Size());
+		sent[index] = true;
+	}
+
+	unsigned kept = 0;
+	for (unsigned i = 0; i < queue.Size(); i++)
+	{
+		if (!sent[i])
+			queue[kept++] = queue[i];
+	}
+	queue.Resize(kept);
+
+	// Forget idle links that are out of debt; they come back with a full budget
+	for (HashMap<Connection*, Link>::Iterator i = links.Begin(); i != links.End();)
+	{
+		bool queued = false;
+		for (unsigned j = 0; j < queue.Size() && !queued; j++)
+			queued = queue[j].connection == i->first_;
+		if (!queued && i->second_.lastInOrderRelease < now && i->second_.budget >= bandwidth * MAX_BURST)
+			i = links.Erase(i);
+		else
+			++i;
+	}
+}
+
+NetworkEmulator::Link& NetworkEmulator::GetLink(Connection* pConnection)
+{
+	HashMap<Connection*, Link>::Iterator i = links.Find(pConnection);
+	if (i != links.End())
+		return i->second_;
+	Link& link = links[pConnection];
+	link.budget = bandwidth * MAX_BURST;
+	return link;
+}
+
+float NetworkEmulator::Random()
+{
+	// Numerical Recipes LCG, as the rest of the game's seeded code uses
+	random = random * 1664525u + 1013904223u;
+	return (random >> 8) / 16777216.0f;
+}
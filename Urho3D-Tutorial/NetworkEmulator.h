@@ -0,0 +1,71 @@
+#pragma once
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Container/Ptr.h>
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/IO/VectorBuffer.h>
+#include <Urho3D/Network/Connection.h>
+
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+// Network condition emulator subsystem, so netcode can be measured on one machine without
+// external tools. Latency and loss come from the transport's own simulation, which covers
+// every packet: Urho3D's traffic (scene replication, controls, remote events) and the game's
+// messages alike, with reliable messages resent by the transport. What the transport cannot
+// do is added here, for the game's own messages (NetworkProtocol.h) only: Send holds each
+// one back for a random jitter and caps each connection's bandwidth, keeping in-order
+// messages in order. A fixed seed makes the jitter repeatable.
+class NetworkEmulator : public Object
+{
+	URHO3D_OBJECT(NetworkEmulator, Object);
+
+public:
+	NetworkEmulator(Context* context);
+
+	// Set the emulated conditions. Bandwidth is bytes per second per connection, 0 for no cap.
+	void SetConditions(int latencyMs, int jitterMs, float lossRate, unsigned bandwidth);
+	// Restart the random sequence behind the jitter
+	void SetSeed(unsigned seed) { random = seed; }
+	// Whether game messages are held back. Latency and loss alone need nothing from Send.
+	bool IsEnabled() const { return jitterMs > 0 || bandwidth > 0; }
+
+	// Send a game message through the connection's emulator, or straight out if there is none or it is off
+	static void Send(Connection* pConnection, int msgID, bool reliable, bool inOrder, const VectorBuffer& msg);
+
+private:
+	// A message waiting for its release time
+	struct Pending
+	{
+		WeakPtr<Connection> connection;
+		int msgID = 0;
+		bool reliable = false;
+		bool inOrder = false;
+		PODVector<unsigned char> data;
+		unsigned releaseTime = 0;
+	};
+
+	// Per-connection state
+	struct Link
+	{
+		// Release time of the newest in-order message; later ones may not overtake it
+		unsigned lastInOrderRelease = 0;
+		// Bytes that may still be sent now
+		float budget = 0.0f;
+	};
+
+	void Queue(Connection* pConnection, int msgID, bool reliable, bool inOrder, const VectorBuffer& msg);
+	// The connection's link, starting a new one with a full budget
+	Link& GetLink(Connection* pConnection);
+	void HandleBeginFrame(StringHash eventType, VariantMap& eventData);
+	// Uniform in [0, 1)
+	float Random();
+
+	Vector<Pending> queue;
+	HashMap<Connection*, Link> links;
+	Timer clock;
+	unsigned lastFrameTime = 0;
+	unsigned random = 1;
+	int jitterMs = 0;
+	unsigned bandwidth = 0;
+};
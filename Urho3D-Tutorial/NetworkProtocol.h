@@ -0,0 +1,40 @@
+#pragma once
+#include <Urho3D/Math/StringHash.h>
+
+// Custom remote event we use to tell the client which object they control
+static const Urho3D::StringHash E_CLIENTOBJECTAUTHORITY("ClientObjectAuthority");
+
+// Identifier for the node ID parameter in the event data
+static const Urho3D::StringHash PLAYER_ID("IDENTITY");
+
+// Custom event on server, client has pressed button that it wants to start game
+static const Urho3D::StringHash E_CLIENTISREADY("ClientReadyToStart");
+
+// Message IDs for the game's own network messages, sent with Connection::SendMessage
+// and received through E_NETWORKMESSAGE. Kept well clear of Urho3D's built-in IDs.
+
+// Server -> client: delta-compressed, quantised state of the whole flock
+static const int MSG_FLOCKSNAPSHOT = 0x200;
+// Client -> server: newest flock snapshot sequence received
+static const int MSG_FLOCKACK = 0x201;
+
+// Lockstep flock (FlockSync). Server -> client: seed, tick, tick length, parameters and exact flock state
+static const int MSG_FLOCKSETUP = 0x202;
+// Server -> client: per-block checksums of the flock at a tick
+static const int MSG_FLOCKKEYFRAME = 0x203;
+// Client -> server: blocks whose checksum didn't match
+static const int MSG_FLOCKRESYNC = 0x204;
+// Server -> client: exact state of the requested blocks at the server's tick
+static const int MSG_FLOCKCORRECTION = 0x205;
+
+// Server -> client: one chunk of a joining client's initial flock state, nearest boids first
+static const int MSG_FLOCKJOIN = 0x207;
+
+// Server -> client: seed the static scenery is generated from (Scenery)
+static const int MSG_SCENERYSEED = 0x206;
+
+// Server -> client: its ball's state after the newest input applied, for prediction (ClientPrediction)
+static const int MSG_PLAYERSTATE = 0x208;
+
+// Client -> server: the newest inputs, numbered, several steps per packet (InputBatch)
+static const int MSG_PLAYERINPUT = 0x209;
@@ -0,0 +1,159 @@
+#include <Urho3D/Core/CoreEvents.h>
+#include <Urho3D/Engine/DebugHud.h>
+#include <Urho3D/Network/Network.h>
+#include <Urho3D/Network/NetworkEvents.h>
+#include <Urho3D/Scene/Scene.h>
+#include "NetworkStats.h"
+
+// Connections listed individually in the debug HUD; the rest only count towards the totals
+static const unsigned MAX_HUD_CONNECTIONS = 8;
+
+static unsigned CountReplicatedNodes(Scene* pScene)
+{
+	if (!pScene)
+		return 0;
+	PODVector<Node*> nodes;
+	pScene->GetChildren(nodes, true);
+	unsigned count = 1;
+	for (unsigned i = 0; i < nodes.Size(); i++)
+	{
+		if (nodes[i]->GetID() < FIRST_LOCAL_ID)
+			count++;
+	}
+	return count;
+}
+
+NetworkStats::NetworkStats(Context* context) : Object(context)
+{
+	SubscribeToEvent(E_NETWORKUPDATE, URHO3D_HANDLER(NetworkStats, HandleNetworkUpdate));
+	SubscribeToEvent(E_NETWORKUPDATESENT, URHO3D_HANDLER(NetworkStats, HandleNetworkUpdateSent));
+	SubscribeToEvent(E_ENDFRAME, URHO3D_HANDLER(NetworkStats, HandleEndFrame));
+}
+
+bool NetworkStats::SetDumpFile(const String& fileName)
+{
+	dumpFile.Reset();
+	if (fileName.Empty())
+		return true;
+
+	dumpFile = new File(context_, fileName, FILE_WRITE);
+	if (!dumpFile->IsOpen())
+	{
+		dumpFile.Reset();
+		return false;
+	}
+	return true;
+}
+
+void NetworkStats::HandleNetworkUpdate(StringHash eventType, VariantMap& eventData)
+{
+	serialisationTimer.Reset();
+}
+
+void NetworkStats::HandleNetworkUpdateSent(StringHash eventType, VariantMap& eventData)
+{
+	long long usec = serialisationTimer.GetUSec(false);
+	serialisationTotal += usec;
+	serialisationMax = Max(serialisationMax, usec);
+	numUpdatesInInterval++;
+}
+
+void NetworkStats::HandleEndFrame(StringHash eventType, VariantMap& eventData)
+{
+	unsigned msec = sampleTimer.GetMSec(false);
+	if (msec < (unsigned)(interval * 1000.0f))
+		return;
+	sampleTimer.Reset();
+
+	TakeSample(msec / 1000.0f);
+	ShowInHud();
+	if (dumpFile)
+		Dump();
+}
+
+void NetworkStats::TakeSample(float elapsed)
+{
+	Network* pNetwork = GetSubsystem<Network>();
+	Vector<SharedPtr<Connection> > sampled;
+	if (pNetwork->GetServerConnection())
+		sampled.Push(SharedPtr<Connection>(pNetwork->GetServerConnection()));
+	else
+		sampled = pNetwork->GetClientConnections();
+
+	HashMap<Connection*, Pair<unsigned long long, unsigned long long> > newTotals;
+	HashMap<Scene*, unsigned> nodeCounts;
+	connections.Resize(sampled.Size());
+	for (unsigned i = 0; i < sampled.Size(); i++)
+	{
+		Connection* pConnection = sampled[i];
+		ConnectionStats& stats = connections[i];
+		stats.address = pConnection->ToString();
+		stats.bytesInPerSec = pConnection->GetBytesInPerSec();
+		stats.bytesOutPerSec = pConnection->GetBytesOutPerSec();
+		stats.packetsInPerSec = pConnection->GetPacketsInPerSec();
+		stats.packetsOutPerSec = pConnection->GetPacketsOutPerSec();
+		stats.roundTripMs = pConnection->GetRoundTripTime();
+
+		Pair<unsigned long long, unsigned long long>& total = newTotals[pConnection];
+		HashMap<Connection*, Pair<unsigned long long, unsigned long long> >::ConstIterator previous = totals.Find(pConnection);
+		if (previous != totals.End())
+			total = previous->second_;
+		total.first_ += (unsigned long long)(stats.bytesInPerSec * elapsed);
+		total.second_ += (unsigned long long)(stats.bytesOutPerSec * elapsed);
+		stats.bytesIn = total.first_;
+		stats.bytesOut = total.second_;
+
+		// Every connection to a scene gets the same nodes, so count each scene once
+		Scene* pScene = pConnection->GetScene();
+		HashMap<Scene*, unsigned>::ConstIterator count = nodeCounts.Find(pScene);
+		if (count == nodeCounts.End())
+			count = nodeCounts.Insert(MakePair(pScene, CountReplicatedNodes(pScene)));
+		stats.replicatedNodesInScene = count->second_;
+	}
+	// Connections that have gone drop out here
+	totals = newTotals;
+
+	numNetworkUpdates = numUpdatesInInterval;
+	serialisationAvgMs = numUpdatesInInterval ? serialisationTotal / 1000.0f / numUpdatesInInterval : 0.0f;
+	serialisationMaxMs = serialisationMax / 1000.0f;
+	serialisationTotal = 0;
+	serialisationMax = 0;
+	numUpdatesInInterval = 0;
+}
+
+void NetworkStats::ShowInHud()
+{
+	DebugHud* pHud = GetSubsystem<DebugHud>();
+	if (!pHud)
+		return;
+
+	pHud->ClearAppStats();
+	pHud->SetAppStats("Net serialise", ToString("%.2f ms avg %.2f ms max", serialisationAvgMs, serialisationMaxMs));
+	pHud->SetAppStats("Net connections", String(connections.Size()));
+	for (unsigned i = 0; i < connections.Size() && i < MAX_HUD_CONNECTIONS; i++)
+	{
+		const ConnectionStats& stats = connections[i];
+		pHud->SetAppStats(stats.address, ToString("in %.0f B/s %d pk/s out %.0f B/s %d pk/s rtt %.0f ms scene nodes %u",
+			stats.bytesInPerSec, stats.packetsInPerSec, stats.bytesOutPerSec, stats.packetsOutPerSec,
+			stats.roundTripMs, stats.replicatedNodesInScene));
+	}
+}
+
+void NetworkStats::Dump()
+{
+	String line = ToString("{\"time\":%u,\"serialiseAvgMs\":%.3f,\"serialiseMaxMs\":%.3f,\"networkUpdates\":%u,\"connections\":[",
+		Time::GetSystemTime(), serialisationAvgMs, serialisationMaxMs, numNetworkUpdates);
+	for (unsigned i = 0; i < connections.Size(); i++)
+	{
+		const ConnectionStats& stats = connections[i];
+		if (i)
+			line += ",";
+		line += ToString("{\"address\":\"%s\",\"bytesInPerSec\":%.0f,\"bytesOutPerSec\":%.0f,\"packetsInPerSec\":%d,"
+			"\"packetsOutPerSec\":%d,\"bytesIn\":%llu,\"bytesOut\":%llu,\"rttMs\":%.1f,\"replicatedNodesInScene\":%u}",
+			stats.address.CString(), stats.bytesInPerSec, stats.bytesOutPerSec, stats.packetsInPerSec,
+			stats.packetsOutPerSec, stats.bytesIn, stats.bytesOut, stats.roundTripMs, stats.replicatedNodesInScene);
+	}
+	line += "]}";
+	dumpFile->WriteLine(line);
+	dumpFile->Flush();
+}
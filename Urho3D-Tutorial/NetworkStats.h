@@ -0,0 +1,82 @@
+#pragma once
+#include <Urho3D/Container/Ptr.h>
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/IO/File.h>
+#include <Urho3D/Network/Connection.h>
+
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+// Traffic figures for one connection at the last sample
+struct ConnectionStats
+{
+	// Remote address and port
+	String address;
+	// Rates as measured by the transport
+	float bytesInPerSec = 0.0f;
+	float bytesOutPerSec = 0.0f;
+	int packetsInPerSec = 0;
+	int packetsOutPerSec = 0;
+	// Totals since the connection was first sampled, integrated from the rates
+	unsigned long long bytesIn = 0;
+	unsigned long long bytesOut = 0;
+	// Round trip time in milliseconds
+	float roundTripMs = 0.0f;
+	// Replicated nodes in the connection's scene: the same for every connection, and not how many
+	// went out this tick. Urho3D's Connection doesn't expose what each update actually sends.
+	unsigned replicatedNodesInScene = 0;
+};
+
+// Network statistics subsystem. Samples every connection (the client connections on a
+// server, the server connection on a client) once per interval, and times serialisation:
+// everything between E_NETWORKUPDATE and E_NETWORKUPDATESENT, which covers the game's own
+// channels and Urho3D's scene replication. Results go to the debug HUD's app stats and,
+// if a dump file is set, to one JSON object per line in that file.
+// Register before anything else subscribes to E_NETWORKUPDATE so the timing includes it.
+class NetworkStats : public Object
+{
+	URHO3D_OBJECT(NetworkStats, Object);
+
+public:
+	NetworkStats(Context* context);
+
+	// Start writing a JSON line per sample to the file. Empty name stops.
+	bool SetDumpFile(const String& fileName);
+
+	// The connections at the last sample
+	const Vector<ConnectionStats>& GetConnections() const { return connections; }
+	// Average and worst serialisation time over the last interval, in milliseconds
+	float GetSerialisationAvgMs() const { return serialisationAvgMs; }
+	float GetSerialisationMaxMs() const { return serialisationMaxMs; }
+	// Network updates in the last interval
+	unsigned GetNumNetworkUpdates() const { return numNetworkUpdates; }
+
+	// Seconds between samples
+	float interval = 1.0f;
+
+private:
+	void HandleNetworkUpdate(StringHash eventType, VariantMap& eventData);
+	void HandleNetworkUpdateSent(StringHash eventType, VariantMap& eventData);
+	void HandleEndFrame(StringHash eventType, VariantMap& eventData);
+
+	// Refresh the connection figures and serialisation timing
+	void TakeSample(float elapsed);
+	// Show the latest sample in the debug HUD
+	void ShowInHud();
+	// Append the latest sample to the dump file
+	void Dump();
+
+	Vector<ConnectionStats> connections;
+	// Totals carried between samples, by connection
+	HashMap<Connection*, Pair<unsigned long long, unsigned long long> > totals;
+	HiresTimer serialisationTimer;
+	long long serialisationTotal = 0;
+	long long serialisationMax = 0;
+	unsigned numUpdatesInInterval = 0;
+	float serialisationAvgMs = 0.0f;
+	float serialisationMaxMs = 0.0f;
+	unsigned numNetworkUpdates = 0;
+	Timer sampleTimer;
+	SharedPtr<File> dumpFile;
+};
@@ -0,0 +1,126 @@
+#include "PlayerRegistry.h"
+#include "Character.h"
+#include "NetworkEmulator.h"
+#include "NetworkProtocol.h"
+
+unsigned PlayerRegistry::Add(Connection* pConnection, Node* pNode)
+{
+	// A connection controls one ball; a second ready event replaces the first ball
+	Remove(pConnection);
+
+	PlayerSlot slot;
+	slot.pConnection = pConnection;
+	slot.pNode = pNode;
+	slot.pRigidBody = pNode->GetComponent<RigidBody>();
+	slot.inputSeq = 0;
+	slot.inputs.Reset();
+	slot.inputs.targetDepth = inputDelay;
+	slotIndices[pConnection] = slots.Size();
+	slots.Push(slot);
+	return slots.Size() - 1;
+}
+
+bool PlayerRegistry::Remove(Connection* pConnection)
+{
+	HashMap<Connection*, unsigned>::Iterator i = slotIndices.Find(pConnection);
+	if (i == slotIndices.End())
+		return false;
+
+	unsigned index = i->second_;
+	slotIndices.Erase(i);
+	slots[index].pNode->Remove();
+
+	// Move the last slot into the hole
+	unsigned last = slots.Size() - 1;
+	if (index != last)
+	{
+		slots[index] = slots[last];
+		slotIndices[slots[index].pConnection] = index;
+	}
+	slots.Pop();
+	return true;
+}
+
+void PlayerRegistry::Clear()
+{
+	for (unsigned i = 0; i < slots.Size(); i++)
+		slots[i].pNode->Remove();
+	slots.Clear();
+	slotIndices.Clear();
+}
+
+int PlayerRegistry::Find(Connection* pConnection) const
+{
+	HashMap<Connection*, unsigned>::ConstIterator i = slotIndices.Find(pConnection);
+	return i != slotIndices.End() ? (int)i->second_ : -1;
+}
+
+void PlayerRegistry::HandleInput(Connection* pConnection, MemoryBuffer& msg)
+{
+	int index = Find(pConnection);
+	if (index >= 0)
+		slots[index].inputs.Receive(msg);
+}
+
+void PlayerRegistry::GatherControls(unsigned tick)
+{
+	for (unsigned i = 0; i < slots.Size(); i++)
+	{
+		PlayerSlot& slot = slots[i];
+		if (slot.inputs.IsActive())
+			slot.inputs.Next(slot.controls, slot.inputSeq, tick);
+		else
+		{
+			slot.controls = slot.pConnection->GetControls();
+			slot.inputSeq = 0;
+		}
+	}
+}
+
+bool PlayerRegistry::TakeLateInputs(PODVector<LateInput>& inputs)
+{
+	for (unsigned i = 0; i < slots.Size(); i++)
+	{
+		PODVector<LateInput>& late = slots[i].inputs.late;
+		for (unsigned j = 0; j < late.Size(); j++)
+		{
+			late[j].nodeID = slots[i].pNode->GetID();
+			inputs.Push(late[j]);
+		}
+		late.Clear();
+	}
+	return !inputs.Empty();
+}
+
+void PlayerRegistry::SendStates()
+{
+	for (unsigned i = 0; i < slots.Size(); i++)
+	{
+		const PlayerSlot& slot = slots[i];
+		if (!slot.inputSeq)
+			continue;
+		msg.Clear();
+		msg.WriteUInt(slot.inputSeq);
+		msg.WriteVector3(slot.pRigidBody->GetPosition());
+		msg.WriteQuaternion(slot.pRigidBody->GetRotation());
+		msg.WriteVector3(slot.pRigidBody->GetLinearVelocity());
+		msg.WriteVector3(slot.pRigidBody->GetAngularVelocity());
+		// Unreliable: the next state supersedes it
+		NetworkEmulator::Send(slot.pConnection, MSG_PLAYERSTATE, false, false, msg);
+	}
+}
+
+void PlayerRegistry::ApplyControls(RigidBody* pRigidBody, const Controls& controls)
+{
+	// Torque is relative to the forward vector
+	Quaternion rotation(0.0f, controls.yaw_, 0.0f);
+	const float MOVE_TORQUE = 5.0f;
+	if (controls.buttons_ & CTRL_FORWARD)
+		pRigidBody->ApplyTorque(rotation * Vector3::RIGHT * MOVE_TORQUE);
+	if (controls.buttons_ & CTRL_BACK)
+		pRigidBody->ApplyTorque(rotation * Vector3::LEFT * MOVE_TORQUE);
+	if (controls.buttons_ & CTRL_LEFT)
+		pRigidBody->ApplyTorque(rotation * Vector3::FORWARD * MOVE_TORQUE);
+	if (controls.buttons_ & CTRL_RIGHT)
+		pRigidBody->ApplyTorque(rotation * Vector3::BACK * MOVE_TORQUE);
+}
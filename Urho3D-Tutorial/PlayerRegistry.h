@@ -0,0 +1,70 @@
+#pragma once
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Container/Vector.h>
+#include <Urho3D/Input/Controls.h>
+#include <Urho3D/IO/VectorBuffer.h>
+#include <Urho3D/Network/Connection.h>
+#include <Urho3D/Physics/RigidBody.h>
+#include <Urho3D/Scene/Node.h>
+#include "InputBatch.h"
+
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+// One player in the game: its connection, the ball it controls and the controls to apply this step
+struct PlayerSlot
+{
+	Connection* pConnection;
+	Node* pNode;
+	RigidBody* pRigidBody;
+	Controls controls;
+	// Sequence number of those controls, 0 for a client that doesn't number them
+	unsigned inputSeq;
+	// Inputs received on the input channel, played out one per step
+	InputJitterBuffer inputs;
+};
+
+// Server side table of the players, packed into dense slots so the per-step
+// work is a linear scan with no hashing or component lookups. The connection
+// map is only touched when players join and leave; leaving swap-removes, so the
+// slots stay packed (and a player's slot index can change when another leaves).
+// The registry owns the balls: Remove and Clear take their nodes out of the scene.
+class PlayerRegistry
+{
+public:
+	PlayerRegistry() {};
+
+	// Add a player for pConnection controlling pNode, which must have a RigidBody. Returns its slot.
+	unsigned Add(Connection* pConnection, Node* pNode);
+	// Remove the connection's player and its ball. False if it had none.
+	bool Remove(Connection* pConnection);
+	// Remove every player and ball
+	void Clear();
+
+	// Slot of the connection's player, or -1. Hashes, so not for per-step use.
+	int Find(Connection* pConnection) const;
+	// Queue a batch of inputs from the connection's client
+	void HandleInput(Connection* pConnection, MemoryBuffer& msg);
+	// Take each player's controls for physics tick: the next input from its jitter buffer,
+	// or the connection's latest controls for a client that doesn't batch (bots)
+	void GatherControls(unsigned tick);
+	// Move every player's late inputs into inputs, with their ball's node ID. False if there were none.
+	bool TakeLateInputs(PODVector<LateInput>& inputs);
+	// Tell every player its ball's state and the newest input in it, for client prediction
+	void SendStates();
+
+	// How a ball responds to controls, on the server and in the owner's prediction
+	static void ApplyControls(RigidBody* pRigidBody, const Controls& controls);
+
+	unsigned Size() const { return slots.Size(); }
+	PlayerSlot& operator [](unsigned index) { return slots[index]; }
+	const PlayerSlot& operator [](unsigned index) const { return slots[index]; }
+
+	// Jitter buffer depth for players added from now on
+	unsigned inputDelay = 2;
+
+private:
+	Vector<PlayerSlot> slots;
+	VectorBuffer msg;
+	HashMap<Connection*, unsigned> slotIndices;
+};
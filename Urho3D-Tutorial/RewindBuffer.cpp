@@ -0,0 +1,152 @@
+#include "RewindBuffer.h"
+
+void RewindBuffer::Configure(float seconds, unsigned tickRate, unsigned capacity)
+{
+	numTicks = Max((unsigned)ceilf(seconds * tickRate), 2U);
+	this->capacity = capacity;
+	tickTime.Resize(numTicks);
+	tickCount.Resize(numTicks);
+	ids.Resize(numTicks * capacity);
+	posX.Resize(numTicks * capacity);
+	posY.Resize(numTicks * capacity);
+	posZ.Resize(numTicks * capacity);
+	Clear();
+}
+
+void RewindBuffer::Clear()
+{
+	head = 0;
+	filled = 0;
+	time = 0.0f;
+	for (unsigned i = 0; i < numTicks; i++)
+		tickCount[i] = 0;
+}
+
+void RewindBuffer::BeginTick(float timeStep)
+{
+	if (!numTicks)
+		return;
+	time += timeStep;
+	head = (head + 1) % numTicks;
+	tickTime[head] = time;
+	tickCount[head] = 0;
+	if (filled < numTicks)
+		filled++;
+}
+
+bool RewindBuffer::Add(unsigned id, const Vector3& position)
+{
+	if (!filled || tickCount[head] >= capacity)
+		return false;
+	unsigned i = head * capacity + tickCount[head]++;
+	ids[i] = id;
+	posX[i] = position.x_;
+	posY[i] = position.y_;
+	posZ[i] = position.z_;
+	return true;
+}
+
+bool RewindBuffer::Replace(unsigned ticksAgo, unsigned id, const Vector3& position)
+{
+	if (ticksAgo >= filled)
+		return false;
+	unsigned tick = (head + numTicks - ticksAgo) % numTicks;
+	int index = FindEntity(tick, id, 0);
+	if (index < 0)
+		return false;
+	unsigned i = tick * capacity + index;
+	posX[i] = position.x_;
+	posY[i] = position.y_;
+	posZ[i] = position.z_;
+	return true;
+}
+
+float RewindBuffer::GetOldestTime() const
+{
+	if (!filled)
+		return time;
+	return tickTime[(head + numTicks - (filled - 1)) % numTicks];
+}
+
+unsigned RewindBuffer::GetMemoryUse() const
+{
+	return numTicks * (sizeof(float) + sizeof(unsigned)) + numTicks * capacity * (3 * sizeof(float) + sizeof(unsigned));
+}
+
+float RewindBuffer::GetViewTime(Connection* pConnection, float interpolationDelay) const
+{
+	// Half the round trip, which the connection gives in milliseconds
+	return time - pConnection->GetRoundTripTime() * 0.0005f - interpolationDelay;
+}
+
+bool RewindBuffer::GetPosition(unsigned id, float atTime, Vector3& position) const
+{
+	int a = FindTick(atTime);
+	if (a < 0)
+		return false;
+	int ia = FindEntity(a, id, 0);
+
+	// Blend towards the next tick, unless atTime is the newest one
+	if ((unsigned)a != head)
+	{
+		unsigned b = (a + 1) % numTicks;
+		int ib = FindEntity(b, id, ia < 0 ? 0 : ia);
+		if (ia >= 0 && ib >= 0)
+		{
+			float t = (atTime - tickTime[a]) / Max(tickTime[b] - tickTime[a], M_EPSILON);
+			position = GetEntity(a, ia).Lerp(GetEntity(b, ib), Clamp(t, 0.0f, 1.0f));
+			return true;
+		}
+		// Joined or left between the two ticks: take whichever has it
+		if (ib >= 0)
+		{
+			position = GetEntity(b, ib);
+			return true;
+		}
+	}
+	if (ia < 0)
+		return false;
+	position = GetEntity(a, ia);
+	return true;
+}
+
+bool RewindBuffer::ValidateHit(unsigned id, float atTime, const Vector3& point, float tolerance) const
+{
+	Vector3 position;
+	if (!GetPosition(id, atTime, position))
+		return false;
+	return (position - point).LengthSquared() <= tolerance * tolerance;
+}
+
+int RewindBuffer::FindTick(float atTime) const
+{
+	if (!filled || atTime < GetOldestTime() || atTime > time)
+		return -1;
+	for (unsigned k = 0; k < filled; k++)
+	{
+		unsigned slot = (head + numTicks - k) % numTicks;
+		if (tickTime[slot] <= atTime)
+			return (int)slot;
+	}
+	return -1;
+}
+
+int RewindBuffer::FindEntity(unsigned tick, unsigned id, unsigned hint) const
+{
+	unsigned base = tick * capacity;
+	unsigned count = tickCount[tick];
+	if (hint < count && ids[base + hint] == id)
+		return (int)hint;
+	for (unsigned i = 0; i < count; i++)
+	{
+		if (ids[base + i] == id)
+			return (int)i;
+	}
+	return -1;
+}
+
+Vector3 RewindBuffer::GetEntity(unsigned tick, unsigned index) const
+{
+	unsigned i = tick * capacity + index;
+	return Vector3(posX[i], posY[i], posZ[i]);
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <Urho3D/Container/Vector.h>
+#include <Urho3D/Math/Vector3.h>
+#include <Urho3D/Network/Connection.h>
+
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+// Server side history of where every boid and player ball was over the last
+// few physics ticks, for lag compensation. A client fires at what it sees,
+// which is the server's world of some time ago; the server rewinds to that
+// time to judge the hit. Only positions are kept, as flat x, y, z and ID
+// arrays in a ring of ticks that is allocated once by Configure, so the memory
+// cost is fixed (GetMemoryUse) rather than a scene snapshot per tick.
+class RewindBuffer
+{
+public:
+	RewindBuffer() {};
+
+	// Keep the given seconds of history at tickRate ticks per second, for up to capacity entities per tick
+	void Configure(float seconds, unsigned tickRate, unsigned capacity);
+	void Clear();
+
+	// After each physics step: start a new tick, then Add every entity's position in it
+	void BeginTick(float timeStep);
+	// Returns false if the tick is already at capacity and the entity was dropped
+	bool Add(unsigned id, const Vector3& position);
+	// Overwrite where entity id was ticksAgo ticks before the newest, after that tick was simulated
+	// again. False if the tick is outside the history or the entity wasn't recorded in it.
+	bool Replace(unsigned ticksAgo, unsigned id, const Vector3& position);
+
+	// Server time of the newest and oldest recorded tick
+	float GetTime() const { return time; }
+	float GetOldestTime() const;
+	// Bytes held by the ring
+	unsigned GetMemoryUse() const;
+
+	// Server time a client was looking at for something it sends now: half a round trip ago,
+	// less the delay it renders remote objects behind by
+	float GetViewTime(Connection* pConnection, float interpolationDelay) const;
+	// Where entity id was at a past server time, between the two ticks around it. False if it
+	// wasn't recorded then or the time is outside the history.
+	bool GetPosition(unsigned id, float atTime, Vector3& position) const;
+	// Hit validation: was entity id within tolerance of the claimed point at that time
+	bool ValidateHit(unsigned id, float atTime, const Vector3& point, float tolerance) const;
+
+private:
+	// Ring slot of the newest tick at or before atTime, -1 if there is none
+	int FindTick(float atTime) const;
+	// Index of entity id within a tick, trying the hint first since order rarely changes between ticks
+	int FindEntity(unsigned tick, unsigned id, unsigned hint) const;
+	Vector3 GetEntity(unsigned tick, unsigned index) const;
+
+	unsigned numTicks = 0;
+	unsigned capacity = 0;
+	unsigned head = 0;
+	unsigned filled = 0;
+	float time = 0.0f;
+	// Per tick
+	PODVector<float> tickTime;
+	PODVector<unsigned> tickCount;
+	// Per tick and entity, at tick * capacity + index
+	PODVector<unsigned> ids;
+	PODVector<float> posX, posY, posZ;
+};
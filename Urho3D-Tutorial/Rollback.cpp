@@ -0,0 +1,209 @@
+#include <Urho3D/Physics/PhysicsWorld.h>
+#include "Rollback.h"
+
+void Rollback::Configure(unsigned maxTicks, unsigned capacity)
+{
+	numTicks = Max(maxTicks, 2U);
+	this->capacity = capacity;
+	unsigned size = numTicks * capacity;
+	tickNumbers.Resize(numTicks);
+	tickCount.Resize(numTicks);
+	ids.Resize(size);
+	posX.Resize(size);
+	posY.Resize(size);
+	posZ.Resize(size);
+	rotW.Resize(size);
+	rotX.Resize(size);
+	rotY.Resize(size);
+	rotZ.Resize(size);
+	linX.Resize(size);
+	linY.Resize(size);
+	linZ.Resize(size);
+	angX.Resize(size);
+	angY.Resize(size);
+	angZ.Resize(size);
+	buttons.Resize(size);
+	yaw.Resize(size);
+	Clear();
+}
+
+void Rollback::Clear()
+{
+	tick = 0;
+	dirtyTick = M_MAX_UNSIGNED;
+	for (unsigned i = 0; i < numTicks; i++)
+	{
+		tickNumbers[i] = M_MAX_UNSIGNED;
+		tickCount[i] = 0;
+	}
+}
+
+unsigned Rollback::GetMemoryUse() const
+{
+	return numTicks * 2 * sizeof(unsigned) + numTicks * capacity * (2 * sizeof(unsigned) + 14 * sizeof(float));
+}
+
+void Rollback::Save(const PlayerRegistry& players)
+{
+	if (!numTicks)
+		return;
+	unsigned slot = tick % numTicks;
+	tickNumbers[slot] = tick++;
+	Store(slot, players, true);
+}
+
+bool Rollback::CorrectInput(const LateInput& input)
+{
+	int slot = FindTick(input.tick);
+	if (slot < 0)
+		return false;
+	unsigned base = slot * capacity;
+	for (unsigned i = 0; i < tickCount[slot]; i++)
+	{
+		if (ids[base + i] != input.nodeID)
+			continue;
+		buttons[base + i] = input.buttons;
+		yaw[base + i] = input.yaw;
+		dirtyTick = Min(dirtyTick, input.tick);
+		return true;
+	}
+	return false;
+}
+
+unsigned Rollback::Resimulate(Scene* pScene, PlayerRegistry& players, RewindBuffer& rewind)
+{
+	unsigned from = dirtyTick;
+	dirtyTick = M_MAX_UNSIGNED;
+	// Need the state the tick started from, i.e. the end of the one before
+	int start = from != M_MAX_UNSIGNED && from ? FindTick(from - 1) : -1;
+	if (start < 0)
+		return 0;
+	PhysicsWorld* pWorld = pScene->GetComponent<PhysicsWorld>();
+	float timeStep = 1.0f / pWorld->GetFps();
+
+	// Balls back to where they were
+	restored.Clear();
+	unsigned base = start * capacity;
+	for (unsigned i = 0; i < tickCount[start]; i++)
+	{
+		for (unsigned p = 0; p < players.Size(); p++)
+		{
+			RigidBody* pRigidBody = players[p].pRigidBody;
+			if (players[p].pNode->GetID() != ids[base + i])
+				continue;
+			unsigned e = base + i;
+			pRigidBody->SetPosition(Vector3(posX[e], posY[e], posZ[e]));
+			pRigidBody->SetRotation(Quaternion(rotW[e], rotX[e], rotY[e], rotZ[e]));
+			pRigidBody->SetLinearVelocity(Vector3(linX[e], linY[e], linZ[e]));
+			pRigidBody->SetAngularVelocity(Vector3(angX[e], angY[e], angZ[e]));
+			restored.Push(pRigidBody);
+		}
+	}
+
+	// Everything else, balls that joined since included, is put back afterwards
+	held.Clear();
+	pScene->GetComponents<RigidBody>(bodies, true);
+	for (unsigned i = 0; i < bodies.Size(); i++)
+	{
+		RigidBody* pRigidBody = bodies[i];
+		if (pRigidBody->GetMass() <= 0.0f || pRigidBody->IsKinematic() || restored.Contains(pRigidBody))
+			continue;
+		HeldBody body = { pRigidBody, pRigidBody->GetPosition(), pRigidBody->GetRotation(),
+			pRigidBody->GetLinearVelocity(), pRigidBody->GetAngularVelocity() };
+		held.Push(body);
+	}
+
+	resimulating = true;
+	for (unsigned t = from; t < tick; t++)
+	{
+		unsigned slot = t % numTicks;
+		base = slot * capacity;
+		for (unsigned i = 0; i < tickCount[slot]; i++)
+		{
+			for (unsigned p = 0; p < players.Size(); p++)
+			{
+				if (players[p].pNode->GetID() != ids[base + i])
+					continue;
+				Controls controls;
+				controls.buttons_ = buttons[base + i];
+				controls.yaw_ = yaw[base + i];
+				PlayerRegistry::ApplyControls(players[p].pRigidBody, controls);
+			}
+		}
+		pWorld->Update(timeStep);
+		// The saved controls stand; the states are what they led to now
+		Store(slot, players, false);
+		// Rewind records one tick per Save, so tick t is tick - 1 - t ticks before its newest
+		for (unsigned p = 0; p < players.Size(); p++)
+			rewind.Replace(tick - 1 - t, players[p].pNode->GetID(), players[p].pNode->GetWorldPosition());
+	}
+	resimulating = false;
+
+	for (unsigned i = 0; i < held.Size(); i++)
+	{
+		const HeldBody& body = held[i];
+		body.pRigidBody->SetPosition(body.position);
+		body.pRigidBody->SetRotation(body.rotation);
+		body.pRigidBody->SetLinearVelocity(body.linearVelocity);
+		body.pRigidBody->SetAngularVelocity(body.angularVelocity);
+	}
+	return tick - from;
+}
+
+int Rollback::FindTick(unsigned atTick) const
+{
+	if (!numTicks || atTick >= tick)
+		return -1;
+	unsigned slot = atTick % numTicks;
+	return tickNumbers[slot] == atTick ? (int)slot : -1;
+}
+
+void Rollback::Store(unsigned slot, const PlayerRegistry& players, bool withControls)
+{
+	unsigned base = slot * capacity;
+	unsigned count = Min(players.Size(), capacity);
+	if (withControls)
+		tickCount[slot] = count;
+	for (unsigned p = 0; p < count; p++)
+	{
+		const PlayerSlot& player = players[p];
+		unsigned e = base + p;
+		// Re-storing after a rollback: keep each ball at its own entry
+		if (!withControls)
+		{
+			unsigned id = player.pNode->GetID();
+			e = M_MAX_UNSIGNED;
+			for (unsigned i = 0; i < tickCount[slot]; i++)
+			{
+				if (ids[base + i] == id)
+					e = base + i;
+			}
+			if (e == M_MAX_UNSIGNED)
+				continue;
+		}
+		else
+		{
+			ids[e] = player.pNode->GetID();
+			buttons[e] = player.controls.buttons_;
+			yaw[e] = player.controls.yaw_;
+		}
+		const RigidBody* pRigidBody = player.pRigidBody;
+		Vector3 position = pRigidBody->GetPosition();
+		Quaternion rotation = pRigidBody->GetRotation();
+		Vector3 linearVelocity = pRigidBody->GetLinearVelocity();
+		Vector3 angularVelocity = pRigidBody->GetAngularVelocity();
+		posX[e] = position.x_;
+		posY[e] = position.y_;
+		posZ[e] = position.z_;
+		rotW[e] = rotation.w_;
+		rotX[e] = rotation.x_;
+		rotY[e] = rotation.y_;
+		rotZ[e] = rotation.z_;
+		linX[e] = linearVelocity.x_;
+		linY[e] = linearVelocity.y_;
+		linZ[e] = linearVelocity.z_;
+		angX[e] = angularVelocity.x_;
+		angY[e] = angularVelocity.y_;
+		angZ[e] = angularVelocity.z_;
+	}
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <Urho3D/Container/Vector.h>
+#include <Urho3D/Physics/RigidBody.h>
+#include <Urho3D/Scene/Scene.h>
+#include "PlayerRegistry.h"
+#include "RewindBuffer.h"
+
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+// Server side rollback for the player balls. After every physics tick each
+// ball's body state and the controls it was stepped with are saved as flat
+// arrays in a ring of ticks allocated once by Configure. When an input turns
+// up after its tick was played with a guess (InputJitterBuffer::late), the
+// tick's controls are corrected; Resimulate then puts the balls back as they
+// were before the earliest corrected tick and steps the physics world forward
+// again to the present, replaying the saved controls. The rest of the world
+// is held at the present: other dynamic bodies are stepped along with the
+// balls and then put back, so only the balls change. The lockstep flock keeps
+// its own per-tick history (DeterministicFlock::Rewind) and doesn't react to
+// the balls, so it is left alone. The lag compensation history is brought in
+// line: each replayed tick's ball positions replace the ones recorded for it.
+// Replayed steps are full PhysicsWorld updates, so they also send the collision
+// events again for bodies that have them on (ContactReport::SetEventsEnabled).
+// Nothing in the game listens to those, but any handler added later should skip
+// them while IsResimulating(), as the physics step handlers already do.
+class Rollback
+{
+public:
+	Rollback() {};
+
+	// Keep maxTicks ticks of state for up to capacity balls per tick
+	void Configure(unsigned maxTicks, unsigned capacity);
+	void Clear();
+
+	// The tick being simulated, which Save records
+	unsigned GetTick() const { return tick; }
+	// True while Resimulate steps the world; physics step handlers should leave the step alone
+	bool IsResimulating() const { return resimulating; }
+	// Bytes held by the ring
+	unsigned GetMemoryUse() const;
+
+	// After each physics step: save every ball and the controls it was given this tick
+	void Save(const PlayerRegistry& players);
+	// Replace the controls a ball was given at a past tick. False if that tick is no longer held.
+	bool CorrectInput(const LateInput& input);
+	// Roll the balls back to the earliest corrected tick and step the world up to the present
+	// again, updating the balls in rewind. Between physics steps only. Returns the number of
+	// ticks simulated again.
+	unsigned Resimulate(Scene* pScene, PlayerRegistry& players, RewindBuffer& rewind);
+
+private:
+	// Where the tick's balls and their controls are held, or -1 if it has been overwritten
+	int FindTick(unsigned atTick) const;
+	// Copy the players' body states into the tick's slot, and their controls if withControls
+	void Store(unsigned slot, const PlayerRegistry& players, bool withControls);
+
+	struct HeldBody
+	{
+		RigidBody* pRigidBody;
+		Vector3 position;
+		Quaternion rotation;
+		Vector3 linearVelocity;
+		Vector3 angularVelocity;
+	};
+
+	unsigned numTicks = 0;
+	unsigned capacity = 0;
+	unsigned tick = 0;
+	// Earliest tick with corrected controls, M_MAX_UNSIGNED if none
+	unsigned dirtyTick = M_MAX_UNSIGNED;
+	bool resimulating = false;
+	// Per tick
+	PODVector<unsigned> tickNumbers;
+	PODVector<unsigned> tickCount;
+	// Per tick and ball, at slot * capacity + index
+	PODVector<unsigned> ids;
+	PODVector<float> posX, posY, posZ;
+	PODVector<float> rotW, rotX, rotY, rotZ;
+	PODVector<float> linX, linY, linZ;
+	PODVector<float> angX, angY, angZ;
+	PODVector<unsigned> buttons;
+	PODVector<float> yaw;
+	// Scratch for Resimulate
+	PODVector<RigidBody*> bodies;
+	PODVector<RigidBody*> restored;
+	PODVector<HeldBody> held;
+};
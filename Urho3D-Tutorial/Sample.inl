@@ -71,6 +71,10 @@ void Sample::Setup()
 
 void Sample::Start()
 {
+    // A headless process has no window, screen or console to set up
+    if (engineParameters_["Headless"].GetBool())
+        return;
+
     if (GetPlatform() == "Android" || GetPlatform() == "iOS")
         // On mobile platform, enable touch by adding a screen joystick
         InitTouchInput();
@@ -0,0 +1,98 @@
+#include <Urho3D/Graphics/Light.h>
+#include <Urho3D/Graphics/Material.h>
+#include <Urho3D/Graphics/Model.h>
+#include <Urho3D/Graphics/StaticModel.h>
+#include <Urho3D/Graphics/Zone.h>
+#include <Urho3D/Physics/CollisionShape.h>
+#include <Urho3D/Physics/RigidBody.h>
+#include "Scenery.h"
+#include "CollisionLayers.h"
+#include "CollisionProxy.h"
+#include "StaticWorldBaker.h"
+
+void Scenery::Generate(Scene* pScene, ResourceCache* pCache, unsigned seed)
+{
+	Clear();
+	this->seed = seed;
+	rng = seed;
+	// Everything created from here on is appended to the scene's children
+	unsigned firstChild = pScene->GetNumChildren();
+
+	// Zone for ambient lighting and fog control
+	Node* zoneNode = pScene->CreateChild("Zone", LOCAL);
+	Zone* zone = zoneNode->CreateComponent<Zone>(LOCAL);
+	zone->SetAmbientColor(Color(0.15f, 0.15f, 0.15f));
+	zone->SetFogColor(Color(0.5f, 0.5f, 0.7f));
+	zone->SetFogStart(100.0f);
+	zone->SetFogEnd(300.0f);
+	zone->SetBoundingBox(BoundingBox(-1000.0f, 1000.0f));
+
+	// Directional light with cascaded shadow mapping
+	Node* lightNode = pScene->CreateChild("DirectionalLight", LOCAL);
+	lightNode->SetDirection(Vector3(0.3f, -0.5f, 0.425f));
+	Light* light = lightNode->CreateComponent<Light>(LOCAL);
+	light->SetLightType(LIGHT_DIRECTIONAL);
+	light->SetCastShadows(true);
+	light->SetShadowBias(BiasParameters(0.00025f, 0.5f));
+	light->SetShadowCascade(CascadeParameters(10.0f, 50.0f, 200.0f, 0.0f, 0.8f));
+	light->SetSpecularIntensity(0.5f);
+
+	// Floor
+	Node* floorNode = pScene->CreateChild("Floor", LOCAL);
+	floorNode->SetPosition(Vector3(0.0f, -0.5f, 0.0f));
+	floorNode->SetScale(Vector3(200.0f, 1.0f, 200.0f));
+	StaticModel* object = floorNode->CreateComponent<StaticModel>(LOCAL);
+	object->SetModel(pCache->GetResource<Model>("Models/Box.mdl"));
+	object->SetMaterial(pCache->GetResource<Material>("Materials/Stone.xml"));
+	RigidBody* body = floorNode->CreateComponent<RigidBody>(LOCAL);
+	// Static world scenery is on collision layer bit 2. The camera raycasts against it and the boxes to stay out of geometry
+	CollisionMatrix::Apply(body, COLGROUP_STATIC);
+	CollisionShape* shape = floorNode->CreateComponent<CollisionShape>(LOCAL);
+	shape->SetBox(Vector3::ONE);
+
+	// Mushrooms of varying sizes
+	const unsigned NUM_MUSHROOMS = 60;
+	for (unsigned i = 0; i < NUM_MUSHROOMS; ++i)
+	{
+		Node* objectNode = pScene->CreateChild("Mushroom", LOCAL);
+		// Separate statements: argument evaluation order is unspecified, and both ends must draw in the same order
+		float x = Random(180.0f) - 90.0f;
+		float z = Random(180.0f) - 90.0f;
+		objectNode->SetPosition(Vector3(x, 0.0f, z));
+		objectNode->SetRotation(Quaternion(0.0f, Random(360.0f), 0.0f));
+		objectNode->SetScale(2.0f + Random(5.0f));
+		StaticModel* object = objectNode->CreateComponent<StaticModel>(LOCAL);
+		object->SetModel(pCache->GetResource<Model>("Models/Mushroom.mdl"));
+		object->SetMaterial(pCache->GetResource<Material>("Materials/Mushroom.xml"));
+		object->SetCastShadows(true);
+		RigidBody* body = objectNode->CreateComponent<RigidBody>(LOCAL);
+		CollisionMatrix::Apply(body, COLGROUP_STATIC);
+		CollisionShape* shape = objectNode->CreateComponent<CollisionShape>(LOCAL);
+		CollisionProxy::Apply(shape, object->GetModel(), false);
+	}
+
+	// Merge the floor and mushrooms into one static body per region. The region nodes are LOCAL too.
+	StaticWorldBaker baker;
+	baker.Bake(pScene);
+
+	const Vector<SharedPtr<Node> >& children = pScene->GetChildren();
+	for (unsigned i = firstChild; i < children.Size(); i++)
+		nodes.Push(WeakPtr<Node>(children[i]));
+}
+
+void Scenery::Clear()
+{
+	for (unsigned i = 0; i < nodes.Size(); i++)
+	{
+		if (nodes[i])
+			nodes[i]->Remove();
+	}
+	nodes.Clear();
+}
+
+float Scenery::Random(float range)
+{
+	// Numerical Recipes LCG, as DeterministicFlock uses
+	rng = rng * 1664525u + 1013904223u;
+	return (rng >> 8) / 16777216.0f * range;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <Urho3D/Container/Ptr.h>
+#include <Urho3D/Container/Vector.h>
+#include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/Scene/Scene.h>
+
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+// The static scenery (zone, light, floor and mushrooms) generated from a seed.
+// Server and clients each build it as LOCAL nodes from the same seed, so a
+// joining client downloads only the seed instead of every scenery node.
+// Its own random generator keeps the layout independent of anything else
+// that calls Random().
+class Scenery
+{
+public:
+	Scenery() {};
+
+	// Seed the current scenery was built from
+	unsigned seed = 0;
+
+	// Remove any scenery built before, then build it from seed and bake its collision
+	// into static world regions. Nodes are direct children of the scene.
+	void Generate(Scene* pScene, ResourceCache* pCache, unsigned seed);
+	// Remove the scenery and its baked regions
+	void Clear();
+
+private:
+	// Uniform in [0, range)
+	float Random(float range);
+
+	unsigned rng = 0;
+	// Everything Generate added to the scene, including the baker's region nodes
+	Vector<WeakPtr<Node> > nodes;
+};
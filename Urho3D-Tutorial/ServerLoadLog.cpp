@@ -0,0 +1,48 @@
+#include <Urho3D/IO/Log.h>
+#include "ServerLoadLog.h"
+
+void ServerLoadLog::BeginFrame()
+{
+	frameTimer.Reset();
+}
+
+void ServerLoadLog::EndFrame(const NetworkStats* pStats)
+{
+	long long usec = frameTimer.GetUSec(false);
+	frameTotal += usec;
+	frameMax = Max(frameMax, usec);
+	numFrames++;
+
+	if (reportTimer.GetMSec(false) >= (unsigned)(interval * 1000.0f))
+	{
+		reportTimer.Reset();
+		Write(pStats);
+	}
+}
+
+void ServerLoadLog::Write(const NetworkStats* pStats)
+{
+	const Vector<ConnectionStats>& connections = pStats->GetConnections();
+	float totalIn = 0.0f;
+	float totalOut = 0.0f;
+	float maxOut = 0.0f;
+	for (unsigned i = 0; i < connections.Size(); i++)
+	{
+		totalIn += connections[i].bytesInPerSec;
+		totalOut += connections[i].bytesOutPerSec;
+		maxOut = Max(maxOut, connections[i].bytesOutPerSec);
+	}
+	unsigned numConnections = connections.Size();
+	float avgIn = numConnections ? totalIn / numConnections : 0.0f;
+	float avgOut = numConnections ? totalOut / numConnections : 0.0f;
+
+	Log::Write(LOG_INFO, ToString("Load: %u connections | tick %.2f ms avg %.2f ms max (%u ticks) | "
+		"replication %.2f ms avg %.2f ms max | per connection in %.0f B/s out %.0f B/s avg, out %.0f B/s max",
+		numConnections,
+		numFrames ? frameTotal / 1000.0f / numFrames : 0.0f, frameMax / 1000.0f, numFrames,
+		pStats->GetSerialisationAvgMs(), pStats->GetSerialisationMaxMs(),
+		avgIn, avgOut, maxOut));
+
+	frameTotal = frameMax = 0;
+	numFrames = 0;
+}
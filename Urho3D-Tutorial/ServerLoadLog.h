@@ -0,0 +1,31 @@
+#pragma once
+#include <Urho3D/Core/Timer.h>
+#include "NetworkStats.h"
+
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+// Periodic log line for a server under load: frame (tick) time, plus the
+// replication cost and per-connection bandwidth that NetworkStats measures.
+class ServerLoadLog
+{
+public:
+	ServerLoadLog() {};
+
+	// Seconds between log lines
+	float interval = 1.0f;
+
+	// Around the frame's work: E_BEGINFRAME to E_POSTRENDERUPDATE. E_ENDFRAME would also
+	// count the frame limiter's sleep, so a limited server would always report its tick period.
+	void BeginFrame();
+	void EndFrame(const NetworkStats* pStats);
+
+private:
+	void Write(const NetworkStats* pStats);
+
+	HiresTimer frameTimer;
+	Timer reportTimer;
+	long long frameTotal = 0;
+	long long frameMax = 0;
+	unsigned numFrames = 0;
+};
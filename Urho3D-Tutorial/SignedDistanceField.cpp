@@ -0,0 +1,102 @@
+#include <Urho3D/Graphics/StaticModel.h>
+#include <Urho3D/Physics/RigidBody.h>
+
+#include "SignedDistanceField.h"
+
+void SignedDistanceField::Build(Scene* pScene, const BoundingBox& bounds, float cellSize)
+{
+	this->cellSize = cellSize;
+	invCellSize = 1.0f / cellSize;
+	origin = bounds.min_;
+	Vector3 size = bounds.Size();
+	sizeX = CeilToInt(size.x_ * invCellSize) + 1;
+	sizeY = CeilToInt(size.y_ * invCellSize) + 1;
+	sizeZ = CeilToInt(size.z_ * invCellSize) + 1;
+	distances.Resize((unsigned)(sizeX * sizeY * sizeZ));
+	for (unsigned i = 0; i < distances.Size(); i++)
+		distances[i] = maxDistance;
+
+	const Vector<SharedPtr<Node> >& children = pScene->GetChildren();
+	for (unsigned i = 0; i < children.Size(); i++)
+	{
+		Node* pNode = children[i];
+		StaticModel* pModel = pNode->GetComponent<StaticModel>();
+		if (!pModel || !pModel->GetModel())
+			continue;
+		RigidBody* pBody = pNode->GetComponent<RigidBody>();
+		if (pBody && pBody->GetMass() > 0.0f)
+			continue;
+		const BoundingBox& box = pModel->GetModel()->GetBoundingBox();
+		Vector3 scale = pNode->GetWorldScale();
+		AddBox(pNode->GetWorldTransform() * box.Center(), pNode->GetWorldRotation(), box.HalfSize() * scale);
+	}
+}
+
+void SignedDistanceField::AddBox(const Vector3& centre, const Quaternion& rotation, const Vector3& halfExtents)
+{
+	// Only cells within maxDistance of the box can change
+	float reach = halfExtents.Length() + maxDistance;
+	int x0 = Max(FloorToInt((centre.x_ - reach - origin.x_) * invCellSize), 0);
+	int y0 = Max(FloorToInt((centre.y_ - reach - origin.y_) * invCellSize), 0);
+	int z0 = Max(FloorToInt((centre.z_ - reach - origin.z_) * invCellSize), 0);
+	int x1 = Min(CeilToInt((centre.x_ + reach - origin.x_) * invCellSize), sizeX - 1);
+	int y1 = Min(CeilToInt((centre.y_ + reach - origin.y_) * invCellSize), sizeY - 1);
+	int z1 = Min(CeilToInt((centre.z_ + reach - origin.z_) * invCellSize), sizeZ - 1);
+
+	Quaternion inverse = rotation.Inverse();
+	for (int z = z0; z <= z1; z++)
+	{
+		for (int y = y0; y <= y1; y++)
+		{
+			for (int x = x0; x <= x1; x++)
+			{
+				Vector3 p = origin + Vector3((float)x, (float)y, (float)z) * cellSize;
+				// Exact box distance: positive outside, negative inside
+				Vector3 q = (inverse * (p - centre)).Abs() - halfExtents;
+				Vector3 outside(Max(q.x_, 0.0f), Max(q.y_, 0.0f), Max(q.z_, 0.0f));
+				float d = outside.Length() + Min(Max(q.x_, Max(q.y_, q.z_)), 0.0f);
+				float& cell = distances[Index(x, y, z)];
+				cell = Min(cell, d);
+			}
+		}
+	}
+}
+
+float SignedDistanceField::Sample(const Vector3& p, Vector3& gradient) const
+{
+	Vector3 g = (p - origin) * invCellSize;
+	int x = FloorToInt(g.x_);
+	int y = FloorToInt(g.y_);
+	int z = FloorToInt(g.z_);
+	if (x < 0 || y < 0 || z < 0 || x >= sizeX - 1 || y >= sizeY - 1 || z >= sizeZ - 1)
+	{
+		gradient = Vector3::ZERO;
+		return maxDistance;
+	}
+	float fx = g.x_ - x, fy = g.y_ - y, fz = g.z_ - z;
+
+	float c000 = distances[Index(x, y, z)];
+	float c100 = distances[Index(x + 1, y, z)];
+	float c010 = distances[Index(x, y + 1, z)];
+	float c110 = distances[Index(x + 1, y + 1, z)];
+	float c001 = distances[Index(x, y, z + 1)];
+	float c101 = distances[Index(x + 1, y, z + 1)];
+	float c011 = distances[Index(x, y + 1, z + 1)];
+	float c111 = distances[Index(x + 1, y + 1, z + 1)];
+
+	// Interpolate along x, then y, then z
+	float c00 = Lerp(c000, c100, fx);
+	float c10 = Lerp(c010, c110, fx);
+	float c01 = Lerp(c001, c101, fx);
+	float c11 = Lerp(c011, c111, fx);
+	float c0 = Lerp(c00, c10, fy);
+	float c1 = Lerp(c01, c11, fy);
+
+	// Gradient of the trilinear interpolant from the same eight corners
+	float dx = Lerp(Lerp(c100 - c000, c110 - c010, fy), Lerp(c101 - c001, c111 - c011, fy), fz);
+	float dy = Lerp(c10 - c00, c11 - c01, fz);
+	float dz = c1 - c0;
+	gradient = Vector3(dx, dy, dz) * invCellSize;
+
+	return Lerp(c0, c1, fz);
+}
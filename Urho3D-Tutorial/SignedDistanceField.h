@@ -0,0 +1,41 @@
+#pragma once
+#include <Urho3D/Container/Vector.h>
+#include <Urho3D/Math/BoundingBox.h>
+#include <Urho3D/Scene/Scene.h>
+
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+// Baked 3D distance field of the static scenery, for cheap obstacle avoidance.
+// Each static model contributes the exact distance to its oriented bounding box.
+// The field is truncated at maxDistance: cells further than that from everything
+// hold maxDistance, which keeps the bake proportional to the scenery's volume.
+class SignedDistanceField
+{
+public:
+	SignedDistanceField() {};
+
+	float maxDistance = 10.0f;
+
+	// Bake every static model among the scene's children (models on nodes with no
+	// body or a massless one) into a grid covering bounds.
+	void Build(Scene* pScene, const BoundingBox& bounds, float cellSize);
+
+	// Trilinear distance at p and its gradient, which points away from the nearest surface.
+	// Outside the grid the distance is maxDistance and the gradient zero.
+	float Sample(const Vector3& p, Vector3& gradient) const;
+
+	bool IsBuilt() const { return !distances.Empty(); }
+
+private:
+	void AddBox(const Vector3& centre, const Quaternion& rotation, const Vector3& halfExtents);
+	unsigned Index(int x, int y, int z) const { return (unsigned)((z * sizeY + y) * sizeX + x); }
+
+	PODVector<float> distances;
+	int sizeX = 0;
+	int sizeY = 0;
+	int sizeZ = 0;
+	Vector3 origin;
+	float cellSize = 1.0f;
+	float invCellSize = 1.0f;
+};
@@ -0,0 +1,107 @@
+#include "SpatialGrid.h"
+
+void SpatialGrid::Build(const Vector3* pPoints, unsigned numPoints, float cellSize)
+{
+	this->pPoints = pPoints;
+	this->numPoints = numPoints;
+	invCellSize = 1.0f / cellSize;
+
+	// Twice as many buckets as points keeps collisions rare
+	unsigned tableSize = 16;
+	while (tableSize < numPoints * 2)
+		tableSize <<= 1;
+	tableMask = tableSize - 1;
+
+	cellStart.Resize(tableSize + 1);
+	cellEntries.Resize(numPoints);
+	pointBucket.Resize(numPoints);
+	for (unsigned i = 0; i <= tableSize; i++)
+		cellStart[i] = 0;
+
+	// Counting sort of the points by bucket
+	for (unsigned i = 0; i < numPoints; i++)
+	{
+		const Vector3& p = pPoints[i];
+		pointBucket[i] = HashCell(ToCell(p.x_), ToCell(p.y_), ToCell(p.z_));
+		cellStart[pointBucket[i] + 1]++;
+	}
+	for (unsigned i = 0; i < tableSize; i++)
+		cellStart[i + 1] += cellStart[i];
+	for (unsigned i = 0; i < numPoints; i++)
+		cellEntries[cellStart[pointBucket[i]]++] = i;
+	// The fill pass advanced each start to the next bucket's start, so shift back down
+	for (unsigned i = tableSize; i > 0; i--)
+		cellStart[i] = cellStart[i - 1];
+	cellStart[0] = 0;
+}
+
+int SpatialGrid::FindNearest(const Vector3& p, float maxRange) const
+{
+	if (!numPoints)
+		return -1;
+
+	int nearest = -1;
+	float bestDistSq = maxRange * maxRange;
+	int x0 = ToCell(p.x_ - maxRange), x1 = ToCell(p.x_ + maxRange);
+	int y0 = ToCell(p.y_ - maxRange), y1 = ToCell(p.y_ + maxRange);
+	int z0 = ToCell(p.z_ - maxRange), z1 = ToCell(p.z_ + maxRange);
+	for (int x = x0; x <= x1; x++)
+	{
+		for (int y = y0; y <= y1; y++)
+		{
+			for (int z = z0; z <= z1; z++)
+			{
+				unsigned h = HashCell(x, y, z);
+				// Hash collisions just mean a few extra distance checks
+				for (unsigned e = cellStart[h]; e < cellStart[h + 1]; e++)
+				{
+					unsigned i = cellEntries[e];
+					float distSq = (pPoints[i] - p).LengthSquared();
+					if (distSq < bestDistSq)
+					{
+						bestDistSq = distSq;
+						nearest = (int)i;
+					}
+				}
+			}
+		}
+	}
+	return nearest;
+}
+
+void SpatialGrid::Query(const Vector3& p, float range, PODVector<unsigned>& result) const
+{
+	if (!numPoints)
+		return;
+
+	float rangeSq = range * range;
+	int x0 = ToCell(p.x_ - range), x1 = ToCell(p.x_ + range);
+	int y0 = ToCell(p.y_ - range), y1 = ToCell(p.y_ + range);
+	int z0 = ToCell(p.z_ - range), z1 = ToCell(p.z_ + range);
+	// Two cells of the search box can hash to the same bucket, visit each bucket once
+	PODVector<unsigned> visited;
+	for (int x = x0; x <= x1; x++)
+	{
+		for (int y = y0; y <= y1; y++)
+		{
+			for (int z = z0; z <= z1; z++)
+			{
+				unsigned h = HashCell(x, y, z);
+				if (visited.Contains(h))
+					continue;
+				visited.Push(h);
+				for (unsigned e = cellStart[h]; e < cellStart[h + 1]; e++)
+				{
+					unsigned i = cellEntries[e];
+					if ((pPoints[i] - p).LengthSquared() <= rangeSq)
+						result.Push(i);
+				}
+			}
+		}
+	}
+}
+
+unsigned SpatialGrid::HashCell(int x, int y, int z) const
+{
+	return ((unsigned)x * 73856093u ^ (unsigned)y * 19349663u ^ (unsigned)z * 83492791u) & tableMask;
+}
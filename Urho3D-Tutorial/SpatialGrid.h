@@ -0,0 +1,40 @@
+#pragma once
+#include <Urho3D/Container/Vector.h>
+#include <Urho3D/Math/Vector3.h>
+
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+// Hashed uniform grid over a flat array of points. Built once per tick so that
+// every query in that tick (e.g. one per missile) is a handful of cell lookups
+// instead of a scan over all points.
+class SpatialGrid
+{
+public:
+	SpatialGrid() {};
+	~SpatialGrid() {};
+
+	// Bin the points into cells of the given size. The points must stay valid until the next Build.
+	void Build(const Vector3* pPoints, unsigned numPoints, float cellSize);
+
+	// Index of the nearest point within maxRange of p, or -1 if there is none.
+	int FindNearest(const Vector3& p, float maxRange) const;
+
+	// Append the indices of all points within range of p.
+	void Query(const Vector3& p, float range, PODVector<unsigned>& result) const;
+
+	unsigned GetNumPoints() const { return numPoints; }
+
+private:
+	unsigned HashCell(int x, int y, int z) const;
+	int ToCell(float v) const { return (int)floorf(v * invCellSize); }
+
+	const Vector3* pPoints = nullptr;
+	unsigned numPoints = 0;
+	float invCellSize = 1.0f;
+	unsigned tableMask = 0;
+	// cellStart[h]..cellStart[h + 1] indexes into cellEntries for hash bucket h
+	PODVector<unsigned> cellStart;
+	PODVector<unsigned> cellEntries;
+	PODVector<unsigned> pointBucket;
+};
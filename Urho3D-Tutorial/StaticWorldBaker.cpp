@@ -0,0 +1,90 @@
+#include "StaticWorldBaker.h"
+#include "CollisionGeometryCache.h"
+
+unsigned StaticWorldBaker::Bake(Scene* pScene)
+{
+	unsigned numBaked = 0;
+	// Source bodies are removed only once the region bodies exist, they serve as templates until then
+	PODVector<RigidBody*> baked;
+	// Copy the child list, baking adds region nodes to the scene
+	Vector<SharedPtr<Node> > children = pScene->GetChildren();
+	for (unsigned i = 0; i < children.Size(); i++)
+	{
+		Node* pNode = children[i];
+		RigidBody* pBody = pNode->GetComponent<RigidBody>();
+		if (!pBody || pBody->GetMass() > 0.0f || pBody->IsKinematic() || pBody->IsTrigger())
+			continue;
+		PODVector<CollisionShape*> shapes;
+		pNode->GetComponents<CollisionShape>(shapes);
+		if (shapes.Empty())
+			continue;
+
+		Vector3 worldPos = pNode->GetWorldPosition();
+		Quaternion worldRot = pNode->GetWorldRotation();
+		Vector3 worldScale = pNode->GetWorldScale();
+		Node* pRegionNode = GetRegion(pScene, worldPos, pBody).pNode;
+		CreateMode mode = pRegionNode->GetID() < FIRST_LOCAL_ID ? REPLICATED : LOCAL;
+
+		for (unsigned j = 0; j < shapes.Size(); j++)
+		{
+			CollisionShape* pSrc = shapes[j];
+			// Region nodes sit at the origin unrotated, so the offsets are just world space
+			CollisionShape* pDst = pRegionNode->CreateComponent<CollisionShape>(mode);
+			pDst->SetShapeType(pSrc->GetShapeType());
+			pDst->SetModel(pSrc->GetModel());
+			pDst->SetLodLevel(pSrc->GetLodLevel());
+			pDst->SetSize(pSrc->GetSize() * worldScale);
+			pDst->SetPosition(worldPos + worldRot * (pSrc->GetPosition() * worldScale));
+			pDst->SetRotation(worldRot * pSrc->GetRotation());
+			pDst->SetMargin(pSrc->GetMargin());
+			pNode->RemoveComponent(pSrc);
+		}
+		baked.Push(pBody);
+		numBaked++;
+	}
+
+	// Add the bodies last: a RigidBody added to a node that already has its shapes builds the
+	// compound once, while adding shapes to a live body rebuilds it every time
+	for (HashMap<unsigned, Region>::Iterator i = regions.Begin(); i != regions.End(); ++i)
+	{
+		Node* pRegionNode = i->second_.pNode;
+		if (pRegionNode->HasComponent<RigidBody>())
+			continue;
+		RigidBody* pTemplate = i->second_.pTemplate;
+		CreateMode mode = pRegionNode->GetID() < FIRST_LOCAL_ID ? REPLICATED : LOCAL;
+		RigidBody* pRegion = pRegionNode->CreateComponent<RigidBody>(mode);
+		pRegion->SetCollisionLayerAndMask(pTemplate->GetCollisionLayer(), pTemplate->GetCollisionMask());
+		pRegion->SetFriction(pTemplate->GetFriction());
+		pRegion->SetRestitution(pTemplate->GetRestitution());
+		pRegion->SetCollisionEventMode(pTemplate->GetCollisionEventMode());
+
+		PODVector<CollisionShape*> shapes;
+		pRegionNode->GetComponents<CollisionShape>(shapes);
+		for (unsigned j = 0; j < shapes.Size(); j++)
+		{
+			if (shapes[j]->GetShapeType() == SHAPE_TRIANGLEMESH || shapes[j]->GetShapeType() == SHAPE_CONVEXHULL)
+				CollisionGeometryCache::Retain(shapes[j]);
+		}
+	}
+	for (unsigned i = 0; i < baked.Size(); i++)
+		baked[i]->Remove();
+
+	return numBaked;
+}
+
+StaticWorldBaker::Region& StaticWorldBaker::GetRegion(Scene* pScene, const Vector3& position, RigidBody* pSource)
+{
+	int x = FloorToInt(position.x_ / regionSize);
+	int z = FloorToInt(position.z_ / regionSize);
+	unsigned key = ((unsigned)(x & 0xffff) << 16) | (unsigned)(z & 0xffff);
+	HashMap<unsigned, Region>::Iterator i = regions.Find(key);
+	if (i != regions.End())
+		return i->second_;
+
+	// Same replication mode as the scenery it replaces
+	CreateMode mode = pSource->GetNode()->GetID() < FIRST_LOCAL_ID ? REPLICATED : LOCAL;
+	Region region;
+	region.pNode = pScene->CreateChild("StaticWorld", mode);
+	region.pTemplate = pSource;
+	return regions[key] = region;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Physics/CollisionShape.h>
+#include <Urho3D/Physics/RigidBody.h>
+#include <Urho3D/Scene/Scene.h>
+
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+// Merges the collision of static scenery into one compound body per square
+// region of the XZ plane, so thousands of props become a handful of broadphase
+// entries. The scenery nodes keep their models for rendering; only their
+// RigidBody and CollisionShapes move. Bodies with mass (dynamic props) are left alone.
+class StaticWorldBaker
+{
+public:
+	StaticWorldBaker() {};
+
+	// Edge length of a region in world units
+	float regionSize = 100.0f;
+
+	// Bake every static body among the scene's direct children. Returns the number of bodies merged.
+	unsigned Bake(Scene* pScene);
+
+	unsigned GetNumRegions() const { return regions.Size(); }
+
+private:
+	struct Region
+	{
+		Node* pNode;
+		// First body baked into the region decides its layer, mask and surface
+		RigidBody* pTemplate;
+	};
+
+	Region& GetRegion(Scene* pScene, const Vector3& position, RigidBody* pSource);
+
+	HashMap<unsigned, Region> regions;
+};
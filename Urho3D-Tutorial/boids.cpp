@@ -1,4 +1,7 @@
 #include "boids.h"
+#include "CollisionLayers.h"
+#include "CollisionProxy.h"
+#include "DeterministicFlock.h"
 
 float Boid::Range_FAttract = 30.0f;
 float Boid::Range_FRepel = 20.0f;
@@ -7,12 +10,42 @@ float Boid::FAttract_Vmax = 5.0f;
 float Boid::FAttract_Factor = 4.0f;
 float Boid::FRepel_Factor = 2.0f;
 float Boid::FAlign_Factor = 2.0f;
+float Boid::Range_FAvoid = 8.0f;
+float Boid::FAvoid_Factor = 6.0f;
+const SignedDistanceField* Boid::pObstacles = nullptr;
+
+void Boid::WriteParameters(Serializer& dest)
+{
+	dest.WriteFloat(Range_FAttract);
+	dest.WriteFloat(Range_FRepel);
+	dest.WriteFloat(Range_FAlign);
+	dest.WriteFloat(FAttract_Vmax);
+	dest.WriteFloat(FAttract_Factor);
+	dest.WriteFloat(FRepel_Factor);
+	dest.WriteFloat(FAlign_Factor);
+	dest.WriteFloat(Range_FAvoid);
+	dest.WriteFloat(FAvoid_Factor);
+}
+
+void Boid::ReadParameters(Deserializer& source)
+{
+	Range_FAttract = source.ReadFloat();
+	Range_FRepel = source.ReadFloat();
+	Range_FAlign = source.ReadFloat();
+	FAttract_Vmax = source.ReadFloat();
+	FAttract_Factor = source.ReadFloat();
+	FRepel_Factor = source.ReadFloat();
+	FAlign_Factor = source.ReadFloat();
+	Range_FAvoid = source.ReadFloat();
+	FAvoid_Factor = source.ReadFloat();
+}
 
 
 
 void Boid::Initialise(ResourceCache* pRes, Scene* pScene)
 {
-	pNode = pScene->CreateChild("Boid");
+	// Local: clients get the flock through FlockServer, not generic node replication
+	pNode = pScene->CreateChild("Boid", LOCAL);
 	pNode->SetPosition(Vector3(Random(40.0f) - 20.0f, 0.0f, Random(40.0f) - 20.0f));
 	pNode->SetRotation(Quaternion(0.0f, Random(360.0f), 0.0f));
 	pNode->SetScale(2.0f + Random(5.0f));
@@ -21,12 +54,13 @@ void Boid::Initialise(ResourceCache* pRes, Scene* pScene)
 	pObject->SetMaterial(pRes->GetResource<Material>("Materials/Stone.xml"));
 	pObject->SetCastShadows(true);
 	pRigidBody = pNode->CreateComponent<RigidBody>();
-	pRigidBody->SetCollisionLayer(2);
+	CollisionMatrix::Apply(pRigidBody, COLGROUP_BOIDS);
 	pRigidBody->SetMass(1.0f);
 	pRigidBody->SetUseGravity(false);
 	pRigidBody->SetPosition(Vector3(Random(40.0f) - 20.0f, 0.0f, Random(40.0f) - 20.0f));
 	pCollisionShape = pNode->CreateComponent<CollisionShape>();
-	pCollisionShape->SetTriangleMesh(pObject->GetModel(), 0);
+	// Dynamic body, so a fitted primitive rather than the cone's triangle mesh
+	CollisionProxy::Apply(pCollisionShape, pObject->GetModel(), true);
 }
 
 void Boid::ComputeForce(Boid* pBoid, bool hasRun)
@@ -164,6 +198,21 @@ void Boid::ComputeForce(Boid* pBoid, bool hasRun)
 			}
 		}
 	}
+
+	//Obstacle avoidance: push away from scenery, harder the closer it is
+	if (pObstacles)
+	{
+		Vector3 gradient;
+		float d = pObstacles->Sample(pRigidBody->GetPosition(), gradient);
+		if (d < Range_FAvoid)
+			force += gradient.Normalized() * (Range_FAvoid - d) * FAvoid_Factor;
+	}
+}
+
+void Boid::AvoidHit(const PhysicsRaycastResult& hit)
+{
+	if (hit.body_)
+		force += hit.normal_ * (BoidLookAhead - hit.distance_) * FAvoid_Factor;
 }
 
 void Boid::Update(float timeStep)
@@ -209,8 +258,30 @@ void BoidSet::Initialise(ResourceCache* pRes, Scene* pScene)
 	}
 }
 
+void BoidSet::SetReplica(bool enable)
+{
+	isReplica = enable;
+	// Replicas are placed from outside, keep physics from moving them
+	for (int i = 0; i < NumBoids; i++)
+	{
+		boidList[i].pRigidBody->SetKinematic(enable);
+	}
+}
+
+void BoidSet::Place(const Vector3* pPositions, const Vector3* pVelocities)
+{
+	for (int i = 0; i < NumBoids; i++)
+	{
+		boidList[i].pNode->SetWorldPosition(pPositions[i]);
+		boidList[i].pNode->SetWorldRotation(DeterministicFlock::Heading(pVelocities[i]));
+	}
+}
+
 void BoidSet::Update(float tm)
 {
+	if (isReplica)
+		return;
+
 	/*for (int i = 0; i < NumBoids; i++)
 	{
 		boidList[i].ComputeForce(&boidList[0]);
@@ -219,20 +290,47 @@ void BoidSet::Update(float tm)
 
 	if (!hasRun)
 	{
+		CastAhead(0, NumBoids / 2);
 		for (int i = 0; i < (NumBoids / 2); i++)
 		{
 			boidList[i].ComputeForce(&boidList[0], hasRun);
+			if (!hits.Empty())
+				boidList[i].AvoidHit(hits[i]);
 			boidList[i].Update(tm);
 		}
 		hasRun = !hasRun;
 	}
 	if (hasRun)
 	{
+		CastAhead(NumBoids / 2, NumBoids);
 		for (int i = (NumBoids / 2); i < NumBoids; i++)
 		{
 			boidList[i].ComputeForce(&boidList[0], hasRun);
+			if (!hits.Empty())
+				boidList[i].AvoidHit(hits[i - NumBoids / 2]);
 			boidList[i].Update(tm);
 		}
 		hasRun = !hasRun;
 	}
+}
+
+void BoidSet::CastAhead(int first, int last)
+{
+	hits.Clear();
+	if (!pWorld || !pQueue)
+		return;
+
+	// Boxes and player balls; other boids are kept apart by the separation rule
+	unsigned mask = CollisionMatrix::GetLayer(COLGROUP_DYNAMIC) | CollisionMatrix::GetLayer(COLGROUP_PLAYERS);
+	queries.Resize(last - first);
+	for (int i = first; i < last; i++)
+	{
+		const RigidBody* pRigidBody = boidList[i].pRigidBody;
+		CastQuery& query = queries[i - first];
+		query.ray = Ray(pRigidBody->GetPosition(), pRigidBody->GetLinearVelocity());
+		query.maxDistance = BoidLookAhead;
+		query.radius = 0.0f;
+		query.collisionMask = mask;
+	}
+	raycaster.Cast(pQueue, pWorld, queries, hits);
 }
\ No newline at end of file
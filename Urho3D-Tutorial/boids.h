@@ -18,8 +18,12 @@
 #include <Urho3D/Physics/PhysicsWorld.h>
 #include <Urho3D/Physics/RigidBody.h>
 #include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/IO/Deserializer.h>
+#include <Urho3D/IO/Serializer.h>
 #include <Urho3D/Scene/Scene.h>
+#include "BatchRaycaster.h"
 #include "BoidSet.h"
+#include "SignedDistanceField.h"
 namespace Urho3D
 {
 	class Node;
@@ -28,6 +32,8 @@ namespace Urho3D
 	class CollisionShape;
 	class ResourceCache;
 	const int NumBoids = 100;	
+	// How far ahead each boid looks for moving bodies (boxes, balls) to steer around
+	const float BoidLookAhead = 10.0f;
 }
 // All Urho3D classes reside in namespace Urho3D
 using namespace Urho3D;
@@ -36,6 +42,9 @@ using namespace Urho3D;
 
 class Boid
 {
+	// Runs the same rules on plain state arrays
+	friend class DeterministicFlock;
+
 	static float Range_FAttract;
 	static float Range_FRepel;
 	static float Range_FAlign;
@@ -43,10 +52,18 @@ class Boid
 	static float FRepel_Factor;
 	static float FAlign_Factor;
 	static float FAttract_Vmax;
-	
+	static float Range_FAvoid;
+	static float FAvoid_Factor;
 	
 
 public:
+	// Baked distance field of the static scenery to steer around, null to ignore scenery
+	static const SignedDistanceField* pObstacles;
+
+	// Flocking parameters, so a server can hand its tuning to clients
+	static void WriteParameters(Serializer& dest);
+	static void ReadParameters(Deserializer& source);
+
 	// Constructor
 	Boid() {Node* pNode = nullptr; RigidBody* pRigidBody = nullptr; CollisionShape* pCollisionShape = nullptr; StaticModel* pObject = nullptr;};
 	
@@ -61,6 +78,8 @@ public:
 	void Initialise(ResourceCache* pRes, Scene* pScene);
 
 	void ComputeForce(Boid* pBoid, bool hasRun);
+	// Steer away from what the look-ahead ray hit, harder the closer it is
+	void AvoidHit(const PhysicsRaycastResult& hit);
 
 	void Update(float timeStep);
 
@@ -74,9 +93,28 @@ public:
 	Boid boidList[NumBoids];
 
 	bool hasRun = false;
+	// Bullet doesn't drive this flock: FlockClient or a DeterministicFlock places it
+	bool isReplica = false;
 
 	BoidSet() {};
 	void Initialise(ResourceCache* pRes, Scene* pScene);
+	void SetObstacles(const SignedDistanceField* pField) { Boid::pObstacles = pField; }
+	// Cast the boids' look-ahead rays against the world's moving bodies in one batch, on the
+	// work queue's threads. The distance field only holds the static scenery.
+	void SetBodyAvoidance(WorkQueue* pQueue, PhysicsWorld* pWorld) { this->pQueue = pQueue; this->pWorld = pWorld; }
+	void SetReplica(bool enable);
+	// Move the nodes to externally simulated states
+	void Place(const Vector3* pPositions, const Vector3* pVelocities);
 	void Update(float tm);
+
+private:
+	// One look-ahead ray per boid in [first, last), into hits
+	void CastAhead(int first, int last);
+
+	WorkQueue* pQueue = nullptr;
+	PhysicsWorld* pWorld = nullptr;
+	BatchRaycaster raycaster;
+	PODVector<CastQuery> queries;
+	PODVector<PhysicsRaycastResult> hits;
 };
 